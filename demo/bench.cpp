@@ -15,12 +15,39 @@ struct stopwatch {
     clock::time_point start = clock::now();
 };
 
+// Dispatched through the virtual resolver::resolve, the generic path, then queued to the
+// ready queue like service.yield, so that both rows differ by the dispatch only
+struct virtual_yield {
+    struct resolver final: uio::resolver {
+        void resolve(int result, uint32_t) noexcept override {
+            this->result = result;
+            uio::schedule_ready(node);
+        }
+
+        uio::ready_node node;
+        int result = 0;
+    };
+
+    io_uring_sqe* sqe;
+    resolver r {};
+
+    constexpr bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+        r.node.handle = handle;
+        io_uring_sqe_set_data(sqe, static_cast<uio::resolver *>(&r));
+    }
+
+    constexpr int await_resume() const noexcept { return r.result; }
+};
+
+constexpr int iteration = 10000000;
+
 int main() {
     using uio::io_service;
     using uio::task;
 
     io_service service;
-    const auto iteration = 10000000;
 
     service.run([] (io_service& service) -> task<> {
         {
@@ -29,6 +56,14 @@ int main() {
                 co_await service.yield();
             }
         }
+        {
+            stopwatch sw("virtual resolver:");
+            for (int i = 0; i < iteration; ++i) {
+                auto* sqe = service.io_uring_get_sqe_safe();
+                io_uring_prep_nop(sqe);
+                co_await virtual_yield { sqe };
+            }
+        }
         {
             stopwatch sw("plain IORING_OP_NOP:");
             for (int i = 0; i < iteration; ++i) {
@@ -56,4 +91,40 @@ int main() {
             }
         }
     }(service));
+
+    // With SQPOLL, a kernel thread consumes sqes, so submitting needs no io_uring_enter
+    // as long as the poller is awake. Keep it spinning through the whole run
+    try {
+        io_service sqpoll(uio::io_service_options {
+            .sqpoll = true,
+            .sq_thread_idle = 2000,
+        });
+
+        sqpoll.run([] (io_service& service) -> task<> {
+            {
+                stopwatch sw("service.yield SQPOLL:");
+                for (int i = 0; i < iteration; ++i) {
+                    co_await service.yield();
+                }
+            }
+            {
+                stopwatch sw("plain NOP SQPOLL:");
+                for (int i = 0; i < iteration; ++i) {
+                    auto* ring = &service.get_handle();
+                    auto* sqe = io_uring_get_sqe(ring);
+                    io_uring_prep_nop(sqe);
+                    io_uring_submit(ring); // Syscall free unless the poller sleeps
+
+                    io_uring_cqe *cqe;
+                    while (io_uring_peek_cqe(ring, &cqe) != 0) {
+                        __builtin_ia32_pause();
+                    }
+                    (void) cqe->res;
+                    io_uring_cqe_seen(ring, cqe);
+                }
+            }
+        }(sqpoll));
+    } catch (std::system_error& e) {
+        fmt::print("SQPOLL unavailable: {}\n", e.what());
+    }
 }
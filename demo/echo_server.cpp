@@ -3,7 +3,6 @@
 #include <sys/ioctl.h>
 #include <netinet/in.h>
 #include <fmt/format.h> // https://github.com/fmtlib/fmt
-#include <vector>
 #include <numeric>
 
 #include <liburing/io_service.hpp>
@@ -19,8 +18,10 @@ enum {
 
 int runningCoroutines = 0;
 
-uio::task<> accept_connection(uio::io_service& service, int serverfd) {
-    while (int clientfd = co_await service.accept(serverfd, nullptr, nullptr)) {
+uio::task<> accept_connection(uio::io_service& service, uio::buffer_ring& buffers, int serverfd) {
+    auto connections = service.accept_multishot(serverfd, nullptr, nullptr);
+    int clientfd;
+    while ((clientfd = co_await connections) >= 0) {
         // [=, &service](int clientfd) -> task<> {
             fmt::print("sockfd {} is accepted; number of running coroutines: {}\n",
                 clientfd, ++runningCoroutines);
@@ -29,7 +30,9 @@ uio::task<> accept_connection(uio::io_service& service, int serverfd) {
             pipe(pipefds) | panic_on_err("pipe", true);
             on_scope_exit([&] { close(pipefds[0]); close(pipefds[1]); });
 #else
-            std::vector<char> buf(BUF_SIZE);
+            // One armed recv feeds the whole connection; buffers are picked
+            // from the shared ring only when data arrives
+            auto chunks = service.recv_multishot(clientfd, buffers, MSG_NOSIGNAL);
 #endif
             while (true) {
 #if USE_POLL
@@ -53,9 +56,9 @@ uio::task<> accept_connection(uio::io_service& service, int serverfd) {
 #   if USE_LINK
 #       error "This won't work because short read of IORING_OP_RECV is not considered an error"
 #   else
-                int r = co_await service.recv(clientfd, buf.data(), BUF_SIZE, MSG_NOSIGNAL);
-                if (r <= 0) break;
-                co_await service.send(clientfd, buf.data(), r, MSG_NOSIGNAL);
+                auto buf = co_await chunks;
+                if (buf.result() <= 0) break;
+                co_await service.send(clientfd, buf.data(), buf.size(), MSG_NOSIGNAL);
 #   endif
 #endif
             }
@@ -83,6 +86,7 @@ int main(int argc, char *argv[]) {
     }
 
     io_service service(MAX_CONN_SIZE);
+    uio::buffer_ring buffers(service.get_handle(), MAX_CONN_SIZE, BUF_SIZE);
 
     int sockfd = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
     on_scope_exit closesock([=]() { shutdown(sockfd, SHUT_RDWR); });
@@ -97,5 +101,5 @@ int main(int argc, char *argv[]) {
     if (listen(sockfd, MAX_CONN_SIZE * 2)) panic("listen", errno);
     fmt::print("Listening: {}\n", server_port);
 
-    service.run(accept_connection(service, sockfd));
+    service.run(accept_connection(service, buffers, sockfd));
 }
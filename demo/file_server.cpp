@@ -12,6 +12,7 @@
 #include <fmt/chrono.h>
 
 #include <liburing/io_service.hpp>
+#include <liburing/cancel_token.hpp>
 
 enum {
     SERVER_PORT = 8080,
@@ -27,6 +28,21 @@ static constexpr const auto http_404_hdr = "HTTP/1.1 404 Not Found\r\nContent-Le
 
 int runningCoroutines = 0;
 
+// Send a chunk of file content, without copying it into socket buffers when
+// the kernel supports it. Returns when `buf` can be reused
+uio::task<> send_chunk(uio::io_service& service, int clientfd, const char* buf, unsigned len, int flags) {
+    using uio::panic_on_err;
+
+    if (!service.is_supported(IORING_OP_SEND_ZC)) {
+        co_await service.send(clientfd, buf, len, flags) | panic_on_err("send", false);
+        co_return;
+    }
+
+    auto op = service.send_zc(clientfd, buf, len, flags);
+    co_await op | panic_on_err("send_zc", false);
+    co_await op.released();
+}
+
 // Serve response
 uio::task<> http_send_file(uio::io_service& service, std::string filename, int clientfd, int dirfd) {
     using uio::on_scope_exit;
@@ -62,30 +78,31 @@ uio::task<> http_send_file(uio::io_service& service, std::string filename, int c
         off_t offset = 0;
         std::array<char, BUF_SIZE> filebuf;
         for (; st.st_size - offset > BUF_SIZE; offset += BUF_SIZE) {
-            auto t = service.read(infd, filebuf.data(), filebuf.size(), offset, IOSQE_IO_LINK) | panic_on_err("read" , false);
-            co_await service.send(clientfd, filebuf.data(), filebuf.size(), MSG_NOSIGNAL | MSG_MORE) | panic_on_err("send", false);
+            // Linked to the send, which fails with -ECANCELED if the read does
+            service.read(infd, filebuf.data(), filebuf.size(), offset, IOSQE_IO_LINK);
+            co_await send_chunk(service, clientfd, filebuf.data(), filebuf.size(), MSG_NOSIGNAL | MSG_MORE);
             auto ts = dur2ts(100ms);
             co_await service.timeout(&ts) | panic_on_err("timeout" , false); // For debugging
         }
         if (st.st_size > offset) {
-            auto t = service.read(infd, filebuf.data(), st.st_size - offset, offset, IOSQE_IO_LINK) | panic_on_err("read", false);
-            co_await service.send(clientfd, filebuf.data(), st.st_size - offset, MSG_NOSIGNAL) | panic_on_err("send", false);
+            service.read(infd, filebuf.data(), st.st_size - offset, offset, IOSQE_IO_LINK);
+            co_await send_chunk(service, clientfd, filebuf.data(), st.st_size - offset, MSG_NOSIGNAL);
         }
     }
 }
 
 // Parse HTTP request header
-uio::task<> serve(uio::io_service& service, int clientfd, int dirfd) {
+uio::task<> serve(uio::io_service& service, uio::buffer_ring& buffers, int clientfd, int dirfd) {
     using uio::panic_on_err;
 
     fmt::print("Serving connection, sockfd {}; number of running coroutines: {}\n",
          clientfd, runningCoroutines);
 
-    std::array<char, BUF_SIZE> buffer;
-
-    int res = co_await service.recv(clientfd, buffer.data(), buffer.size(), 0) | panic_on_err("recv", false);
+    // Don't let slow clients keep the connection forever
+    auto buffer = co_await uio::with_timeout(service.recv(clientfd, buffers, 0), 10s);
+    buffer.result() | panic_on_err("recv", false);
 
-    std::string_view buf_view = std::string_view(buffer.data(), size_t(res));
+    std::string_view buf_view = buffer.view();
 
     // We only handle GET requests, for simplification
     if (buf_view.compare(0, 3, "GET") == 0) {
@@ -98,16 +115,18 @@ uio::task<> serve(uio::io_service& service, int clientfd, int dirfd) {
     }
 }
 
-uio::task<> accept_connection(uio::io_service& service, int serverfd, int dirfd) {
+uio::task<> accept_connection(uio::io_service& service, uio::buffer_ring& buffers, int serverfd, int dirfd) {
     using uio::task;
 
-    while (int clientfd = co_await service.accept(serverfd, nullptr, nullptr)) {
+    auto connections = service.accept_multishot(serverfd, nullptr, nullptr);
+    int clientfd;
+    while ((clientfd = co_await connections) >= 0) {
         // Start worker coroutine to handle new requests
-        [=, &service](int clientfd) -> task<> {
+        [=, &service, &buffers](int clientfd) -> task<> {
             ++runningCoroutines;
             auto start = std::chrono::high_resolution_clock::now();
             try {
-                co_await serve(service, clientfd, dirfd);
+                co_await serve(service, buffers, clientfd, dirfd);
             } catch (std::exception& e) {
                 fmt::print("sockfd {} crashed with exception: {}\n",
                     clientfd,
@@ -156,7 +175,8 @@ int main(int argc, char* argv[]) {
     fmt::print("Listening: {}\n", SERVER_PORT);
 
     io_service service;
+    uio::buffer_ring buffers(service.get_handle(), 64, BUF_SIZE);
 
     // Start main coroutine ( for co_await )
-    service.run(accept_connection(service, sockfd, dirfd));
+    service.run(accept_connection(service, buffers, sockfd, dirfd));
 }
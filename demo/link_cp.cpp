@@ -2,9 +2,12 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <optional>
+#include <system_error>
 #include <vector>
 
 #include <liburing/io_service.hpp>
+#include <liburing/fixed_file_table.hpp>
 
 #define BS (1024)
 
@@ -26,25 +29,23 @@ static off_t get_file_size(int fd) {
     throw std::runtime_error("Unsupported file type");
 }
 
-uio::task<> copy_file(uio::io_service& service, off_t insize) {
-    using uio::on_scope_exit;
-    using uio::to_iov;
+uio::task<> copy_file(uio::io_service& service, uio::fixed_buffer_pool& pool, uio::fixed_fd infd, uio::fixed_fd outfd, off_t insize) {
     using uio::panic_on_err;
 
-    std::vector<char> buf(BS, '\0');
-    service.register_buffers({ to_iov(buf.data(), buf.size()) });
-    on_scope_exit unreg_bufs([&]() { service.unregister_buffers(); });
+    auto buf = pool.acquire();
 
+    // A failed request cancels the rest of the chain, so checking the last one is enough
     off_t offset = 0;
     for (; offset < insize - BS; offset += BS) {
-        service.read_fixed(0, buf.data(), buf.size(), offset, 0, IOSQE_FIXED_FILE | IOSQE_IO_LINK) | panic_on_err("read_fixed(1)", false);
-        service.write_fixed(1, buf.data(), buf.size(), offset, 0, IOSQE_FIXED_FILE | IOSQE_IO_LINK) | panic_on_err("write_fixed(1)", false);
+        service.read_fixed(infd, buf, offset, IOSQE_IO_LINK);
+        service.write_fixed(outfd, buf, BS, offset, IOSQE_IO_LINK);
     }
 
     int left = insize - offset;
-    service.read_fixed(0, buf.data(), left, offset, 0, IOSQE_FIXED_FILE | IOSQE_IO_LINK) | panic_on_err("read_fixed(2)", false);
-    service.write_fixed(1, buf.data(), left, offset, 0, IOSQE_FIXED_FILE) | panic_on_err("write_fixed(2)", false);
-    co_await service.fsync(1, 0, IOSQE_FIXED_FILE);
+    // A short read would break the link, read exactly what's left
+    service.read_fixed(infd, buf.data(), left, offset, buf.buf_index(), IOSQE_IO_LINK);
+    co_await service.write_fixed(outfd, buf, left, offset) | panic_on_err("write_fixed", false);
+    co_await service.fsync(outfd, 0);
 }
 
 int main(int argc, char *argv[]) {
@@ -65,8 +66,20 @@ int main(int argc, char *argv[]) {
 
     off_t insize = get_file_size(infd);
     io_service service;
-    service.register_files({ infd, outfd });
-    on_scope_exit unreg_file([&]() { service.unregister_files(); });
+    std::optional<uio::fixed_file_table> files;
+    try {
+        files.emplace(service, 2, 2);
+    } catch (const std::system_error& e) {
+        fprintf(stderr, "Sparse file table is not supported by this kernel (%s)\n", e.what());
+        return 1;
+    }
+    std::optional<uio::fixed_buffer_pool> pool;
+    try {
+        pool.emplace(service.get_handle(), uio::fixed_buffer_pool_options { .slice_size = BS, .slices_per_region = 1, .max_regions = 1 });
+    } catch (const std::system_error& e) {
+        fprintf(stderr, "Sparse buffer table is not supported by this kernel (%s)\n", e.what());
+        return 1;
+    }
 
-    service.run(copy_file(service, insize));
+    service.run(copy_file(service, *pool, files->install(infd), files->install(outfd), insize));
 }
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <liburing/stdlib_coroutine.hpp>
+#include <liburing/frame_allocator.hpp>
+
+namespace uio {
+template <typename T>
+class async_generator;
+
+// only for internal usage
+template <typename T>
+struct async_generator_promise {
+    using value_type = std::remove_reference_t<T>;
+
+    // Coroutine frames are allocated by the frame allocator of current thread
+    static void* operator new(size_t size) {
+        return allocate_frame(size);
+    }
+    static void operator delete(void* ptr, size_t size) noexcept {
+        deallocate_frame(ptr, size);
+    }
+
+    // Transfer to the consumer awaiting the next item, without going through the run loop
+    struct yield_awaiter {
+        constexpr bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<async_generator_promise> self) const noexcept {
+            return self.promise().consumer_;
+        }
+
+        constexpr void await_resume() const noexcept {}
+    };
+
+    async_generator<T> get_return_object() noexcept;
+    auto initial_suspend() noexcept { return std::suspend_always(); }
+    yield_awaiter final_suspend() noexcept { return {}; }
+
+    // The item lives in the generator frame, until it's resumed
+    yield_awaiter yield_value(value_type& value) noexcept {
+        value_ = std::addressof(value);
+        return {};
+    }
+    yield_awaiter yield_value(value_type&& value) noexcept {
+        value_ = std::addressof(value);
+        return {};
+    }
+
+    void return_void() noexcept {}
+
+    void unhandled_exception() noexcept {
+        exception_ = std::current_exception();
+    }
+
+private:
+    friend class async_generator<T>;
+    std::coroutine_handle<> consumer_;
+    value_type* value_ = nullptr;
+    std::exception_ptr exception_;
+};
+
+/**
+ * A coroutine producing a stream of items with `co_yield`, awaited one at a time
+ * Unlike `task`, it's lazily executed: the body runs when the next item is awaited, and
+ * may await requests in between. Each item is handed over to the consumer by symmetric
+ * transfer, in place, so no item is copied nor allocated
+ * @code
+ * for (auto it = co_await gen.begin(); it != gen.end(); co_await ++it) { use(*it); }
+ * while (auto* item = co_await gen.next()) { use(*item); }
+ * @endcode
+ * @warning do NOT destroy the generator while the next item is being awaited
+ */
+template <typename T>
+class [[nodiscard]] async_generator {
+public:
+    using promise_type = async_generator_promise<T>;
+    using handle_t = std::coroutine_handle<promise_type>;
+    using value_type = typename promise_type::value_type;
+
+    /** Only for placeholder */
+    async_generator() noexcept = default;
+
+    async_generator(const async_generator&) = delete;
+    async_generator& operator =(const async_generator&) = delete;
+
+    async_generator(async_generator&& other) noexcept: coro_(std::exchange(other.coro_, nullptr)) {}
+
+    async_generator& operator =(async_generator&& other) noexcept {
+        if (coro_) coro_.destroy();
+        coro_ = std::exchange(other.coro_, nullptr);
+        return *this;
+    }
+
+    ~async_generator() {
+        if (coro_) coro_.destroy();
+    }
+
+    /** Resume the generator until it yields an item or returns
+     * @return an awaitable resolved with a pointer to the item, valid until the generator is
+     *         resumed again, or nullptr once it has returned. An exception thrown by the
+     *         generator is rethrown
+     */
+    auto next() noexcept {
+        struct await_next: advance_awaiter {
+            value_type* await_resume() const {
+                return this->resume_result();
+            }
+        };
+
+        return await_next { { coro_ } };
+    }
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = async_generator::value_type;
+        using reference = value_type&;
+        using pointer = value_type*;
+
+        iterator() noexcept = default;
+
+        reference operator *() const noexcept {
+            return *coro_.promise().value_;
+        }
+
+        pointer operator ->() const noexcept {
+            return coro_.promise().value_;
+        }
+
+        /** Resume the generator until it yields the next item
+         * @return an awaitable resolved with this iterator
+         */
+        auto operator ++() noexcept {
+            struct await_increment: advance_awaiter {
+                iterator* it;
+
+                iterator& await_resume() const {
+                    this->resume_result();
+                    return *it;
+                }
+            };
+
+            return await_increment { { coro_ }, this };
+        }
+
+        bool operator ==(std::default_sentinel_t) const noexcept {
+            return !coro_ || coro_.done();
+        }
+
+    private:
+        friend class async_generator;
+        explicit iterator(handle_t coro) noexcept: coro_(coro) {}
+        handle_t coro_;
+    };
+
+    /** Resume the generator until it yields the first item
+     * @return an awaitable resolved with an iterator, equal to `end()` if it has returned
+     */
+    auto begin() noexcept {
+        struct await_begin: advance_awaiter {
+            iterator await_resume() const {
+                this->resume_result();
+                return iterator(this->coro);
+            }
+        };
+
+        return await_begin { { coro_ } };
+    }
+
+    std::default_sentinel_t end() const noexcept {
+        return std::default_sentinel;
+    }
+
+    /** Get is the generator returned */
+    bool done() const noexcept {
+        return !coro_ || coro_.done();
+    }
+
+private:
+    friend struct async_generator_promise<T>;
+    explicit async_generator(handle_t coro) noexcept: coro_(coro) {}
+
+    // Resumes the generator in place of the awaiting coroutine, which gets resumed by
+    // the generator when it yields or returns
+    struct advance_awaiter {
+        handle_t coro;
+
+        bool await_ready() const noexcept {
+            return !coro || coro.done();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) const noexcept {
+            coro.promise().consumer_ = consumer;
+            return coro;
+        }
+
+        value_type* resume_result() const {
+            if (!coro) return nullptr;
+            auto& promise = coro.promise();
+            if (promise.exception_) std::rethrow_exception(std::exchange(promise.exception_, nullptr));
+            return coro.done() ? nullptr : promise.value_;
+        }
+    };
+
+    handle_t coro_;
+};
+
+template <typename T>
+async_generator<T> async_generator_promise<T>::get_return_object() noexcept {
+    return async_generator<T>(std::coroutine_handle<async_generator_promise>::from_promise(*this));
+}
+
+} // namespace uio
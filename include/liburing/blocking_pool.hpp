@@ -0,0 +1,254 @@
+#pragma once
+
+#include <cerrno>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+#include <sys/eventfd.h>
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+/**
+ * A fixed set of threads running blocking functions ( getaddrinfo, compression, hashing... )
+ * on behalf of coroutines
+ * `co_await pool.run(service, fn)` queues `fn` without allocating, and returns its result
+ * or rethrows its exception. Jobs are run in FIFO order by the first idle worker, so a
+ * long one never delays those queued after it while another worker is idle. The worker resumes the coroutine on the
+ * ring of `service` by posting a cqe to it ( IORING_OP_MSG_RING ); if unsupported, by
+ * writing an eventfd read by that ring. No thread is created per call.
+ */
+class blocking_pool {
+public:
+    /** Start worker threads
+     * @param threads number of workers, 0 for one per CPU
+     */
+    explicit blocking_pool(unsigned threads = 0) {
+        if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+        workers.reserve(threads);
+        for (unsigned i = 0; i < threads; ++i) {
+            auto& w = *workers.emplace_back(std::make_unique<worker>());
+            // MSG_RING needs a ring to be submitted from. It's only used by this worker
+            if (io_uring_queue_init(4, &w.ring, 0) == 0) {
+                w.has_ring = true;
+                if (i == 0) msg_ring = probe_msg_ring(w.ring);
+            }
+            msg_ring = msg_ring && w.has_ring;
+        }
+        for (auto& w : workers) {
+            w->thread = std::thread(&blocking_pool::worker_main, this, std::ref(*w));
+        }
+    }
+
+    /** Run functions already queued, then join worker threads
+     * @warning every coroutine awaiting `run` must be resumed before destroying the pool
+     */
+    ~blocking_pool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        queued.notify_all();
+        for (auto& w : workers) {
+            w->thread.join();
+            if (w->has_ring) io_uring_queue_exit(&w->ring);
+        }
+    }
+
+    blocking_pool(const blocking_pool&) = delete;
+    blocking_pool& operator =(const blocking_pool&) = delete;
+
+    /** Number of workers */
+    size_t size() const noexcept {
+        return workers.size();
+    }
+
+    /** Run `fn` on a worker thread
+     * @param service io_service running the awaiting coroutine, which is resumed by it
+     * @param fn function to run, which mustn't touch `service`
+     * @return an awaitable resolved with the result of `fn`, or rethrowing its exception
+     */
+    template <typename Fn>
+    auto run(io_service& service, Fn&& fn) {
+        using result_t = std::invoke_result_t<std::decay_t<Fn>&>;
+        using value_t = std::conditional_t<std::is_void_v<result_t>, std::monostate, result_t>;
+
+        struct await_job final: job {
+            await_job(blocking_pool& pool, io_service& service, Fn&& fn)
+                : fn(std::forward<Fn>(fn)), pool(&pool), service(&service) {}
+
+            void execute() noexcept override {
+                try {
+                    if constexpr (std::is_void_v<result_t>) {
+                        fn();
+                        result.template emplace<1>();
+                    } else {
+                        result.template emplace<1>(fn());
+                    }
+                } catch (...) {
+                    result.template emplace<2>(std::current_exception());
+                }
+            }
+
+            constexpr bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                resolver.handle = handle;
+                user_data = resolver.user_data();
+                if (pool->msg_ring && service->is_supported(IORING_OP_MSG_RING)) {
+                    target_fd = service->get_handle().ring_fd;
+                } else {
+                    efd = acquire_eventfd();
+                    auto* sqe = service->io_uring_get_sqe_safe();
+                    io_uring_prep_read(sqe, efd, &efd_value, sizeof(efd_value), 0);
+                    io_uring_sqe_set_data(sqe, user_data);
+                }
+                pool->submit(this);
+            }
+
+            result_t await_resume() {
+                if (efd >= 0) release_eventfd(std::exchange(efd, -1));
+                if (auto* pep = std::get_if<2>(&result)) std::rethrow_exception(*pep);
+                if constexpr (!std::is_void_v<result_t>) {
+                    return std::move(std::get<1>(result));
+                }
+            }
+
+            std::decay_t<Fn> fn;
+            std::variant<std::monostate, value_t, std::exception_ptr> result;
+            resume_resolver resolver {};
+            blocking_pool* pool;
+            io_service* service;
+            eventfd_t efd_value = 0;
+        };
+
+        return await_job(*this, service, std::forward<Fn>(fn));
+    }
+
+private:
+    struct job {
+        virtual void execute() noexcept {}
+
+        job* next = nullptr;
+        // Where to post the completion: a ring with MSG_RING, or an eventfd
+        int target_fd = -1;
+        int efd = -1;
+        void* user_data = nullptr;
+
+    protected:
+        ~job() = default;
+    };
+
+    struct worker {
+        std::thread thread;
+        io_uring ring;
+        bool has_ring = false;
+    };
+
+    static bool probe_msg_ring(io_uring& ring) noexcept {
+        auto* probe = io_uring_get_probe_ring(&ring);
+        if (!probe) return false;
+        bool supported = io_uring_opcode_supported(probe, IORING_OP_MSG_RING);
+        io_uring_free_probe(probe);
+        return supported;
+    }
+
+    // Eventfds of the fallback path are recycled per thread, instead of created per call
+    struct eventfd_cache {
+        ~eventfd_cache() {
+            for (int fd : fds) ::close(fd);
+        }
+        std::vector<int> fds;
+    };
+
+    static eventfd_cache& local_eventfds() noexcept {
+        thread_local eventfd_cache cache;
+        return cache;
+    }
+
+    static int acquire_eventfd() {
+        auto& fds = local_eventfds().fds;
+        if (!fds.empty()) {
+            int fd = fds.back();
+            fds.pop_back();
+            return fd;
+        }
+        int fd = ::eventfd(0, EFD_CLOEXEC);
+        if (fd < 0) panic("eventfd", errno);
+        return fd;
+    }
+
+    static void release_eventfd(int fd) {
+        local_eventfds().fds.push_back(fd);
+    }
+
+    void submit(job* j) noexcept {
+        {
+            std::lock_guard lock(mutex);
+            j->next = nullptr;
+            (tail ? tail->next : head) = j;
+            tail = j;
+        }
+        queued.notify_one();
+    }
+
+    // Pop the oldest job, waiting for one. Returns nullptr once stopping and drained
+    job* pop() noexcept {
+        std::unique_lock lock(mutex);
+        queued.wait(lock, [this] { return head || stopping; });
+        if (!head) return nullptr;
+        auto* j = std::exchange(head, head->next);
+        if (!head) tail = nullptr;
+        return j;
+    }
+
+    static void complete(worker& w, job* j) noexcept {
+        if (j->efd >= 0) {
+            ::eventfd_write(j->efd, 1);
+            return;
+        }
+        for (;;) {
+            auto* sqe = io_uring_get_sqe(&w.ring);
+            io_uring_prep_msg_ring(sqe, j->target_fd, 0, reinterpret_cast<uintptr_t>(j->user_data), 0);
+            io_uring_sqe_set_data(sqe, nullptr);
+            // MSG_RING completes inline almost always, so this doesn't block in practice
+            io_uring_submit_and_wait(&w.ring, 1);
+            io_uring_cqe* cqe;
+            io_uring_peek_cqe(&w.ring, &cqe);
+            int res = cqe->res;
+            io_uring_cqe_seen(&w.ring, cqe);
+            if (res >= 0) return;
+            // The coroutine could never be resumed if the target ring is gone or invalid, a bug
+            // of the caller: fail loudly instead of hanging it
+            if (res != -EOVERFLOW && res != -EAGAIN) panic("io_uring_prep_msg_ring", -res);
+            // CQ ring of the target is full, retry until it's reaped
+            std::this_thread::yield();
+        }
+    }
+
+    void worker_main(worker& w) noexcept {
+        // NOTE: a job lives in the frame of its coroutine, which may be gone once completed
+        while (auto* j = pop()) {
+            j->execute();
+            complete(w, j);
+        }
+    }
+
+    std::vector<std::unique_ptr<worker>> workers;
+    bool msg_ring = false;
+    // Intrusive FIFO of queued jobs, shared by every worker. Jobs are blocking calls, so
+    // the lock is never contended for long
+    std::mutex mutex;
+    std::condition_variable queued;
+    job* head = nullptr;
+    job* tail = nullptr;
+    bool stopping = false;
+};
+
+} // namespace uio
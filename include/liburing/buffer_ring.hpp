@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <liburing.h>
+
+#include <liburing/stdlib_coroutine.hpp>
+#include <liburing/sqe_awaitable.hpp>
+#include <liburing/utils.hpp>
+
+namespace uio {
+/**
+ * A ring of provided buffers. The kernel picks one of them when a request
+ * issued with IOSQE_BUFFER_SELECT is ready to transfer data
+ * @see io_uring_register(2) IORING_REGISTER_PBUF_RING
+ * @note Buffers are shared by every request selecting from the group, so memory
+ *       usage scales with data in flight rather than with number of connections
+ */
+class buffer_ring {
+public:
+    /** Allocate and register a provided buffer ring
+     * @param ring io_uring handle, see io_service::get_handle
+     * @param entries number of buffers, must be a power of 2
+     * @param buf_size size of each buffer
+     * @param bgid buffer group id used by requests selecting from this ring
+     */
+    buffer_ring(io_uring& ring, unsigned entries, unsigned buf_size, int bgid = 0)
+        : ring(&ring)
+        , entries(entries)
+        , buf_size(buf_size)
+        , bgid(bgid)
+        , storage(new char[size_t(entries) * buf_size]) {
+        int ret = 0;
+        br = io_uring_setup_buf_ring(&ring, entries, bgid, 0, &ret);
+        if (!br) panic("io_uring_setup_buf_ring", -ret);
+
+        for (unsigned i = 0; i < entries; ++i) {
+            io_uring_buf_ring_add(br, buffer(i), buf_size, i, io_uring_buf_ring_mask(entries), i);
+        }
+        io_uring_buf_ring_advance(br, entries);
+    }
+
+    /** Unregister and free the buffer ring */
+    ~buffer_ring() noexcept {
+        io_uring_free_buf_ring(ring, br, entries, bgid);
+    }
+
+    buffer_ring(const buffer_ring&) = delete;
+    buffer_ring& operator =(const buffer_ring&) = delete;
+
+    /** Buffer group id, used as sqe->buf_group */
+    int group_id() const noexcept {
+        return bgid;
+    }
+
+    /** Size of each buffer */
+    unsigned buffer_size() const noexcept {
+        return buf_size;
+    }
+
+    /** Get the memory of buffer `bid` */
+    char* buffer(uint16_t bid) const noexcept {
+        return storage.get() + size_t(bid) * buf_size;
+    }
+
+    /** Give buffer `bid` back to the kernel */
+    void recycle(uint16_t bid) noexcept {
+        io_uring_buf_ring_add(br, buffer(bid), buf_size, bid, io_uring_buf_ring_mask(entries), 0);
+        io_uring_buf_ring_advance(br, 1);
+    }
+
+private:
+    io_uring* ring;
+    io_uring_buf_ring* br;
+    unsigned entries;
+    unsigned buf_size;
+    int bgid;
+    std::unique_ptr<char[]> storage;
+};
+
+/**
+ * A buffer picked by the kernel from a buffer_ring
+ * The buffer is given back to the ring when the lease is destroyed
+ */
+class buffer_lease {
+public:
+    buffer_lease() noexcept = default;
+
+    /** Take the buffer reported by a cqe, if any
+     * @param result cqe->res
+     * @param cqe_flags cqe->flags
+     */
+    buffer_lease(buffer_ring& ring, int result, uint32_t cqe_flags) noexcept: res(result) {
+        if (cqe_flags & IORING_CQE_F_BUFFER) {
+            this->ring = &ring;
+            bid = uint16_t(cqe_flags >> IORING_CQE_BUFFER_SHIFT);
+        }
+    }
+
+    buffer_lease(buffer_lease&& other) noexcept
+        : ring(std::exchange(other.ring, nullptr))
+        , res(other.res)
+        , bid(other.bid) {}
+
+    buffer_lease& operator =(buffer_lease&& other) noexcept {
+        release();
+        ring = std::exchange(other.ring, nullptr);
+        res = other.res;
+        bid = other.bid;
+        return *this;
+    }
+
+    ~buffer_lease() noexcept {
+        release();
+    }
+
+    /** Result of the request, i.e. bytes transferred or -errno */
+    int result() const noexcept {
+        return res;
+    }
+
+    /** Does this lease hold a buffer */
+    explicit operator bool() const noexcept {
+        return ring != nullptr;
+    }
+
+    /** Id of the buffer chosen by kernel */
+    uint16_t buffer_id() const noexcept {
+        return bid;
+    }
+
+    char* data() const noexcept {
+        return ring ? ring->buffer(bid) : nullptr;
+    }
+
+    /** Bytes transferred into the buffer */
+    size_t size() const noexcept {
+        return ring && res > 0 ? size_t(res) : 0;
+    }
+
+    std::string_view view() const noexcept {
+        return { data(), size() };
+    }
+
+    /** Give the buffer back to its ring before the lease is destroyed */
+    void release() noexcept {
+        if (ring) std::exchange(ring, nullptr)->recycle(bid);
+    }
+
+private:
+    buffer_ring* ring = nullptr;
+    int res = 0;
+    uint16_t bid = 0;
+};
+
+/**
+ * Awaitable of a request issued with IOSQE_BUFFER_SELECT
+ * @warning a buffer picked for a request that is never awaited is never given back
+ */
+struct buffer_awaitable {
+    buffer_awaitable(io_uring_sqe* sqe, buffer_ring& ring, io_service* service = nullptr) noexcept
+        : sqe(sqe), ring(&ring), service(service) {}
+
+    /** Resume the awaiting coroutine with `priority` once the request completes
+     * @return a copy of this awaitable
+     */
+    buffer_awaitable with_priority(resume_priority priority) const noexcept {
+        auto op = *this;
+        op.priority = priority;
+        return op;
+    }
+
+    auto operator co_await() {
+        struct await_buffer {
+            resume_resolver resolver {};
+            io_uring_sqe* sqe;
+            buffer_ring* ring;
+
+            await_buffer(io_uring_sqe* sqe, buffer_ring* ring, resume_priority priority): sqe(sqe), ring(ring) {
+                resolver.priority = priority;
+            }
+
+            constexpr bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                resolver.handle = handle;
+                io_uring_sqe_set_data(sqe, resolver.user_data());
+            }
+
+            buffer_lease await_resume() const noexcept {
+                return buffer_lease(*ring, resolver.result, resolver.flags);
+            }
+        };
+
+        return await_buffer(sqe, ring, priority);
+    }
+
+private:
+    template <typename> friend struct deadline_awaitable;
+    io_uring_sqe* sqe;
+    buffer_ring* ring;
+    io_service* service;
+    resume_priority priority = resume_priority::normal;
+};
+
+} // namespace uio
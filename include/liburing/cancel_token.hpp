@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cassert>
+#include <chrono>
+#include <utility>
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+/**
+ * A source of cancellation for in-flight requests, like std::stop_source
+ * Requests are attached with `with_cancel`. `cancel()` issues IORING_OP_ASYNC_CANCEL
+ * for each of them, which then complete with -ECANCELED. Requests attached after
+ * cancellation are cancelled right after being issued.
+ * @note like io_service, it's NOT thread safe
+ */
+class cancel_token {
+public:
+    /** An in-flight request attached to a token, linked intrusively */
+    struct registration {
+        void* user_data = nullptr;
+        registration* prev = nullptr;
+        registration* next = nullptr;
+    };
+
+    cancel_token(io_service& service) noexcept: service(&service) {}
+
+    cancel_token(const cancel_token&) = delete;
+    cancel_token& operator =(const cancel_token&) = delete;
+
+#ifndef NDEBUG
+    ~cancel_token() {
+        assert(!head && "cancel_token is destructed while requests are attached");
+    }
+#endif
+
+    /** Is cancellation requested */
+    bool cancelled() const noexcept {
+        return cancelled_;
+    }
+
+    /** Request cancellation of every attached request */
+    void cancel() noexcept {
+        if (cancelled_) return;
+        cancelled_ = true;
+        for (auto* r = head; r; r = r->next) {
+            issue_cancel(r->user_data);
+        }
+    }
+
+    void attach(registration& r) noexcept {
+        if (cancelled_) issue_cancel(r.user_data);
+        r.prev = nullptr;
+        r.next = head;
+        if (head) head->prev = &r;
+        head = &r;
+    }
+
+    void detach(registration& r) noexcept {
+        if (r.prev) r.prev->next = r.next;
+        else head = r.next;
+        if (r.next) r.next->prev = r.prev;
+        r.prev = r.next = nullptr;
+    }
+
+private:
+    void issue_cancel(void* user_data) noexcept {
+        auto* sqe = service->io_uring_get_sqe_safe();
+        io_uring_prep_cancel(sqe, user_data, 0);
+        io_uring_sqe_set_data(sqe, internal_user_data);
+    }
+
+    io_service* service;
+    registration* head = nullptr;
+    bool cancelled_ = false;
+};
+
+/**
+ * An awaitable whose request is cancelled when its cancel_token is
+ * Works with any awaitable whose awaiter resolves through a `resolver` member
+ * ( sqe_awaitable, buffer_awaitable, deadline_awaitable )
+ */
+template <typename Awaitable>
+struct cancellable_awaitable {
+    cancellable_awaitable(Awaitable&& op, cancel_token& token) noexcept
+        : op(std::move(op)), token(&token) {}
+
+    auto operator co_await() {
+        using inner_t = decltype(std::declval<Awaitable&>().operator co_await());
+
+        struct await_cancellable {
+            inner_t inner;
+            cancel_token* token;
+            cancel_token::registration reg {};
+
+            bool await_ready() noexcept { return inner.await_ready(); }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                inner.await_suspend(handle);
+                reg.user_data = inner.resolver.user_data();
+                token->attach(reg);
+            }
+
+            decltype(auto) await_resume() noexcept {
+                token->detach(reg);
+                return inner.await_resume();
+            }
+        };
+
+        return await_cancellable { op.operator co_await(), token };
+    }
+
+private:
+    Awaitable op;
+    cancel_token* token;
+};
+
+/** Cancel the request of `op` when `token` is cancelled
+ * @return an awaitable resolved with the result of `op`, or -ECANCELED
+ */
+template <typename Awaitable>
+cancellable_awaitable<Awaitable> with_cancel(Awaitable op, cancel_token& token) noexcept {
+    return cancellable_awaitable<Awaitable>(std::move(op), token);
+}
+
+/**
+ * An awaitable whose request is followed by a linked IORING_OP_LINK_TIMEOUT
+ * The request is cancelled if it's not completed before the deadline
+ * @note The timeout sqe refers to `ts` stored in this object. Moving the object
+ *       updates the sqe, so it must be moved only before being submitted, i.e. awaited
+ */
+template <typename Awaitable>
+struct deadline_awaitable {
+    deadline_awaitable(Awaitable&& op, std::chrono::nanoseconds dur) noexcept
+        : op(std::move(op)), ts(dur2ts(dur)) {
+        assert(this->op.service && "deadline_awaitable requires a request issued by io_service");
+        // Both are reserved together, a deadline left alone in the next submission is dropped
+        timeout_sqe = this->op.service->io_uring_get_linked_sqe_safe(this->op.sqe);
+        this->op.sqe->flags |= IOSQE_IO_LINK;
+        io_uring_prep_link_timeout(timeout_sqe, &ts, 0);
+        io_uring_sqe_set_data(timeout_sqe, internal_user_data);
+    }
+
+    deadline_awaitable(deadline_awaitable&& other) noexcept
+        : op(std::move(other.op)), ts(other.ts), timeout_sqe(other.timeout_sqe) {
+        timeout_sqe->addr = reinterpret_cast<uintptr_t>(&ts);
+    }
+
+    auto operator co_await() {
+        return op.operator co_await();
+    }
+
+private:
+    Awaitable op;
+    __kernel_timespec ts;
+    io_uring_sqe* timeout_sqe;
+};
+
+/** Cancel the request of `op` if it's not completed within `dur`
+ * @see io_uring_enter(2) IORING_OP_LINK_TIMEOUT
+ * @param op a request just issued, i.e. no other sqe is gotten after it
+ * @return an awaitable resolved with the result of `op`, or -ECANCELED on timeout
+ * @warning the returned object MUST be awaited, or the timeout sqe refers to a destroyed timespec
+ */
+template <typename Awaitable>
+deadline_awaitable<Awaitable> with_timeout(Awaitable op, std::chrono::nanoseconds dur) noexcept {
+    return deadline_awaitable<Awaitable>(std::move(op), dur);
+}
+
+} // namespace uio
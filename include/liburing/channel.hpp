@@ -0,0 +1,434 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include <liburing/io_service.hpp>
+#include <liburing/mpmc_queue.hpp>
+#include <liburing/sync.hpp>
+
+namespace uio {
+/**
+ * A bounded channel for coroutines running on one io_service
+ * Items are stored in a ring buffer allocated once. `co_await send(v)` suspends while the
+ * buffer is full, `co_await recv()` while it's empty. An item sent to a suspended receiver
+ * is handed over directly, and the receiver is queued to be resumed. Never enters the kernel.
+ * @note like io_service, it's NOT thread safe. See cross_ring_channel
+ */
+template <typename T>
+class channel {
+public:
+    /** @param capacity maximum number of buffered items, at least 1 */
+    explicit channel(size_t capacity)
+        : buffer(new std::optional<T>[capacity])
+        , capacity_(capacity) {
+        assert(capacity && "capacity of a channel must be at least 1");
+    }
+
+    channel(const channel&) = delete;
+    channel& operator =(const channel&) = delete;
+
+#ifndef NDEBUG
+    ~channel() {
+        assert(senders.empty() && receivers.empty() && "channel is destructed while coroutines are waiting");
+    }
+#endif
+
+    /** Send an item without waiting
+     * @param value moved from only if sent
+     * @return false if the buffer is full or the channel is closed
+     */
+    bool try_send(T& value) {
+        if (closed_) return false;
+        if (auto* r = static_cast<recv_waiter *>(receivers.pop())) {
+            // The buffer is empty if anyone is waiting for it
+            r->value.emplace(std::move(value));
+            schedule_ready(*r);
+            return true;
+        }
+        if (count == capacity_) return false;
+        buffer[(head + count) % capacity_].emplace(std::move(value));
+        ++count;
+        return true;
+    }
+
+    /** Send an item
+     * @return an awaitable resolved with true once the item is sent, false if the channel is closed
+     */
+    auto send(T value) noexcept(std::is_nothrow_move_constructible_v<T>) {
+        struct await_send: send_waiter {
+            channel* ch;
+
+            bool await_ready() {
+                this->sent = ch->try_send(this->value);
+                return this->sent || ch->closed_;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                this->handle = handle;
+                ch->senders.push(this);
+            }
+
+            bool await_resume() const noexcept { return this->sent; }
+        };
+
+        return await_send { { {}, std::move(value) }, this };
+    }
+
+    /** Receive the oldest item without waiting, nullopt if there's none */
+    std::optional<T> try_recv() {
+        if (!count) return std::nullopt;
+        auto& slot = buffer[head];
+        std::optional<T> result(std::move(slot));
+        slot.reset();
+        head = (head + 1) % capacity_;
+        --count;
+        // Refill the slot from the first blocked sender
+        if (auto* s = static_cast<send_waiter *>(senders.pop())) {
+            buffer[(head + count) % capacity_].emplace(std::move(s->value));
+            ++count;
+            s->sent = true;
+            schedule_ready(*s);
+        }
+        return result;
+    }
+
+    /** Receive an item
+     * @return an awaitable resolved with the oldest item, or nullopt once the channel is
+     *         closed and every buffered item is received
+     */
+    auto recv() noexcept {
+        struct await_recv: recv_waiter {
+            channel* ch;
+
+            bool await_ready() {
+                this->value = ch->try_recv();
+                return this->value || ch->closed_;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                this->handle = handle;
+                ch->receivers.push(this);
+            }
+
+            std::optional<T> await_resume() { return std::move(this->value); }
+        };
+
+        return await_recv { {}, this };
+    }
+
+    /** Close the channel
+     * Pending and later sends fail, receivers get buffered items then nullopt
+     */
+    void close() noexcept {
+        closed_ = true;
+        auto* r = receivers.take_all();
+        while (r) {
+            schedule_ready(*std::exchange(r, r->next));
+        }
+        auto* s = senders.take_all();
+        while (s) {
+            schedule_ready(*std::exchange(s, s->next));
+        }
+    }
+
+    bool closed() const noexcept {
+        return closed_;
+    }
+
+    /** Number of buffered items */
+    size_t size() const noexcept {
+        return count;
+    }
+
+    size_t capacity() const noexcept {
+        return capacity_;
+    }
+
+private:
+    struct send_waiter: ready_node {
+        T value;
+        bool sent = false;
+    };
+
+    struct recv_waiter: ready_node {
+        std::optional<T> value;
+    };
+
+    std::unique_ptr<std::optional<T>[]> buffer;
+    size_t capacity_;
+    size_t head = 0;
+    size_t count = 0;
+    waiter_queue senders;
+    waiter_queue receivers;
+    bool closed_ = false;
+};
+
+/**
+ * A bounded channel for coroutines running on different io_services, i.e. threads
+ * Items go through a lock free mpmc_queue, so as long as the channel is neither full nor
+ * empty, sending and receiving never block nor enter the kernel. A coroutine only sleeps
+ * when it can't make progress, and is woken by its own ring: queued by schedule_ready if
+ * it's the ring of the waking coroutine, or by posting a cqe to it ( IORING_OP_MSG_RING )
+ * @note waiters are managed under a spin lock, which is only taken by coroutines about to
+ *       sleep, and by those waking them up
+ */
+template <typename T>
+class cross_ring_channel {
+public:
+    /** @param capacity maximum number of buffered items, must be a power of 2 */
+    explicit cross_ring_channel(size_t capacity): queue(capacity) {}
+
+    cross_ring_channel(const cross_ring_channel&) = delete;
+    cross_ring_channel& operator =(const cross_ring_channel&) = delete;
+
+#ifndef NDEBUG
+    ~cross_ring_channel() {
+        assert(senders.empty() && receivers.empty() && "cross_ring_channel is destructed while coroutines are waiting");
+    }
+#endif
+
+    /** Send an item without waiting
+     * @param service io_service running the calling coroutine, used to wake a receiver up
+     * @param value moved from only if sent
+     * @return false if the buffer is full or the channel is closed
+     */
+    bool try_send(io_service& service, T& value) {
+        if (closed_.load(std::memory_order_relaxed) || !queue.try_push(value)) return false;
+        wake_waiters(service);
+        return true;
+    }
+
+    /** Send an item
+     * @param service io_service running the awaiting coroutine, which is resumed by it
+     * @return an awaitable resolved with true once the item is sent, false if the channel is closed
+     */
+    auto send(io_service& service, T value) noexcept(std::is_nothrow_move_constructible_v<T>) {
+        struct await_send: send_waiter {
+            cross_ring_channel* ch;
+
+            bool await_ready() {
+                this->sent = ch->try_send(*this->service, this->value);
+                return this->sent || ch->closed_.load(std::memory_order_relaxed);
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle) {
+                this->resolver.handle = handle;
+                {
+                    typename spin_lock::guard lock(ch->lock);
+                    if (ch->closed_.load(std::memory_order_relaxed)) return false;
+                    // Announce before retrying, so that either the retry sees a slot
+                    // freed concurrently, or the receiver freeing it sees us
+                    ch->blocked_senders.fetch_add(1, std::memory_order_seq_cst);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (!ch->queue.try_push(this->value)) {
+                        ch->senders.push(this);
+                        return true;
+                    }
+                    ch->blocked_senders.fetch_sub(1, std::memory_order_relaxed);
+                }
+                this->sent = true;
+                ch->wake_waiters(*this->service);
+                return false;
+            }
+
+            bool await_resume() const noexcept { return this->sent; }
+        };
+
+        return await_send { { { {}, {}, &service }, std::move(value) }, this };
+    }
+
+    /** Receive the oldest item without waiting, nullopt if there's none
+     * @param service io_service running the calling coroutine, used to wake a sender up
+     */
+    std::optional<T> try_recv(io_service& service) {
+        auto result = queue.try_pop();
+        if (result) wake_waiters(service);
+        return result;
+    }
+
+    /** Receive an item
+     * @param service io_service running the awaiting coroutine, which is resumed by it
+     * @return an awaitable resolved with the oldest item, or nullopt once the channel is
+     *         closed and every buffered item is received
+     */
+    auto recv(io_service& service) noexcept {
+        struct await_recv: recv_waiter {
+            cross_ring_channel* ch;
+
+            bool await_ready() {
+                this->value = ch->try_recv(*this->service);
+                return this->value || ch->closed_.load(std::memory_order_acquire);
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle) {
+                this->resolver.handle = handle;
+                {
+                    typename spin_lock::guard lock(ch->lock);
+                    if (ch->closed_.load(std::memory_order_relaxed)) return false;
+                    ch->blocked_receivers.fetch_add(1, std::memory_order_seq_cst);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    this->value = ch->queue.try_pop();
+                    if (!this->value) {
+                        ch->receivers.push(this);
+                        return true;
+                    }
+                    ch->blocked_receivers.fetch_sub(1, std::memory_order_relaxed);
+                }
+                ch->wake_waiters(*this->service);
+                return false;
+            }
+
+            std::optional<T> await_resume() {
+                // Closed while waiting, or before suspending. Items sent concurrently
+                // with closing are still buffered
+                if (!this->value) this->value = ch->try_recv(*this->service);
+                return std::move(this->value);
+            }
+        };
+
+        return await_recv { { { {}, {}, &service }, std::nullopt }, this };
+    }
+
+    /** Close the channel
+     * Pending and later sends fail, receivers get buffered items then nullopt
+     * @param service io_service running the calling coroutine, used to wake waiters up
+     */
+    void close(io_service& service) noexcept {
+        closed_.store(true, std::memory_order_release);
+        ready_node* r;
+        ready_node* s;
+        {
+            typename spin_lock::guard lock(this->lock);
+            r = receivers.take_all();
+            s = senders.take_all();
+            blocked_receivers.store(0, std::memory_order_relaxed);
+            blocked_senders.store(0, std::memory_order_relaxed);
+        }
+        while (r) {
+            auto* w = static_cast<recv_waiter *>(std::exchange(r, r->next));
+            resume_on_ring(service, *w->service, w->resolver);
+        }
+        while (s) {
+            auto* w = static_cast<send_waiter *>(std::exchange(s, s->next));
+            resume_on_ring(service, *w->service, w->resolver);
+        }
+    }
+
+    bool closed() const noexcept {
+        return closed_.load(std::memory_order_relaxed);
+    }
+
+    /** Number of buffered items, only a hint */
+    size_t size() const noexcept {
+        return queue.size();
+    }
+
+    size_t capacity() const noexcept {
+        return queue.capacity();
+    }
+
+private:
+    // Waiters live in awaiters, thus coroutine frames. Only ready_node::next is used, to
+    // link them; they're resumed through resolver instead
+    struct ring_waiter: ready_node {
+        resume_resolver resolver;
+        io_service* service;
+    };
+
+    struct send_waiter: ring_waiter {
+        T value;
+        bool sent = false;
+    };
+
+    struct recv_waiter: ring_waiter {
+        std::optional<T> value;
+    };
+
+    class spin_lock {
+    public:
+        // Holds the lock for its scope
+        class guard {
+        public:
+            explicit guard(spin_lock& owner) noexcept: owner(owner) {
+                owner.lock();
+            }
+
+            ~guard() {
+                owner.unlock();
+            }
+
+            guard(const guard&) = delete;
+            guard& operator =(const guard&) = delete;
+
+        private:
+            spin_lock& owner;
+        };
+
+        void lock() noexcept {
+            while (locked.exchange(true, std::memory_order_acquire)) {
+                while (locked.load(std::memory_order_relaxed)) cpu_relax();
+            }
+        }
+
+        void unlock() noexcept {
+            locked.store(false, std::memory_order_release);
+        }
+
+    private:
+        static void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        }
+
+        std::atomic<bool> locked = false;
+    };
+
+    // Called after pushing or popping an item: push items of blocked senders to slots
+    // freed, and hand items over to blocked receivers, until neither can make progress
+    void wake_waiters(io_service& service) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (blocked_senders.load(std::memory_order_relaxed) || blocked_receivers.load(std::memory_order_relaxed)) {
+            send_waiter* s = nullptr;
+            recv_waiter* r = nullptr;
+            {
+                typename spin_lock::guard lock(this->lock);
+                // Slots and items may be taken by running coroutines already
+                auto* front = static_cast<send_waiter *>(senders.front());
+                if (front && queue.try_push(front->value)) {
+                    s = static_cast<send_waiter *>(senders.pop());
+                    blocked_senders.fetch_sub(1, std::memory_order_relaxed);
+                    s->sent = true;
+                }
+                if (!receivers.empty()) {
+                    if (auto value = queue.try_pop()) {
+                        r = static_cast<recv_waiter *>(receivers.pop());
+                        blocked_receivers.fetch_sub(1, std::memory_order_relaxed);
+                        r->value = std::move(value);
+                    }
+                }
+            }
+            if (!s && !r) return;
+            if (s) resume_on_ring(service, *s->service, s->resolver);
+            if (r) resume_on_ring(service, *r->service, r->resolver);
+        }
+    }
+
+    mpmc_queue<T> queue;
+    spin_lock lock;
+    waiter_queue senders;
+    waiter_queue receivers;
+    // Number of coroutines in `senders` and `receivers`, read without the lock
+    std::atomic<size_t> blocked_senders = 0;
+    std::atomic<size_t> blocked_receivers = 0;
+    std::atomic<bool> closed_ = false;
+};
+
+} // namespace uio
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+#include <liburing.h>
+
+#include <liburing/stdlib_coroutine.hpp>
+#include <liburing/sqe_awaitable.hpp>
+#include <liburing/utils.hpp>
+
+namespace uio {
+class fixed_buffer_pool;
+
+/**
+ * A slice of a fixed_buffer_pool, knowing the index of the registered buffer it's in
+ * The slice is given back to the pool when destroyed
+ * @see io_service::read_fixed io_service::write_fixed
+ */
+class fixed_buffer {
+public:
+    fixed_buffer() noexcept = default;
+
+    fixed_buffer(fixed_buffer&& other) noexcept
+        : pool(std::exchange(other.pool, nullptr))
+        , ptr(other.ptr)
+        , index(other.index) {}
+
+    fixed_buffer& operator =(fixed_buffer&& other) noexcept {
+        release();
+        pool = std::exchange(other.pool, nullptr);
+        ptr = other.ptr;
+        index = other.index;
+        return *this;
+    }
+
+    ~fixed_buffer() noexcept {
+        release();
+    }
+
+    /** Whether a slice is held */
+    explicit operator bool() const noexcept {
+        return pool;
+    }
+
+    char* data() const noexcept {
+        return ptr;
+    }
+
+    inline size_t size() const noexcept;
+
+    /** Index of the registered buffer, i.e. `buf_index` of read_fixed / write_fixed */
+    int buf_index() const noexcept {
+        return index;
+    }
+
+    /** View of the first `n` bytes, e.g. those read */
+    std::string_view view(size_t n) const noexcept {
+        return { ptr, n };
+    }
+
+    /** Give the slice back to the pool before destroying */
+    inline void release() noexcept;
+
+private:
+    friend class fixed_buffer_pool;
+
+    fixed_buffer(fixed_buffer_pool& pool, char* ptr, uint16_t index) noexcept
+        : pool(&pool)
+        , ptr(ptr)
+        , index(index) {}
+
+    fixed_buffer_pool* pool = nullptr;
+    char* ptr = nullptr;
+    uint16_t index = 0;
+};
+
+/** Options of fixed_buffer_pool */
+struct fixed_buffer_pool_options {
+    /** Size of each slice handed out by `acquire` */
+    size_t slice_size = 4096;
+    /** Number of slices of each region, i.e. each registered buffer */
+    size_t slices_per_region = 256;
+    /** Maximum number of regions the pool can grow to, i.e. size of the buffer table */
+    unsigned max_regions = 16;
+    /** Back regions with huge pages ( MAP_HUGETLB ), or normal pages if none is available */
+    bool huge_pages = false;
+};
+
+/**
+ * Memory registered to the kernel once, handed out as slices of equal size
+ * Requests on registered buffers ( read_fixed / write_fixed ) skip pinning and
+ * unpinning the pages per request. The pool registers a sparse buffer table, then
+ * grows by registering a new region into the next free index, when it runs out of slices
+ * @see io_uring_register(2) IORING_REGISTER_BUFFERS2 IORING_REGISTER_BUFFERS_UPDATE
+ * @note a ring has only one buffer table, don't mix with io_service::register_buffers.
+ *       Like io_service, it's NOT thread safe
+ */
+class fixed_buffer_pool {
+public:
+    /** Register a sparse buffer table, and the first region
+     * @param ring io_uring handle, see io_service::get_handle
+     * @throw std::system_error if registering or allocating memory fails
+     */
+    explicit fixed_buffer_pool(io_uring& ring, const fixed_buffer_pool_options& options = {})
+        : ring(&ring)
+        , options(options) {
+        assert(options.slice_size && options.slices_per_region && options.max_regions && "empty fixed_buffer_pool");
+        io_uring_register_buffers_sparse(&ring, options.max_regions) | panic_on_err("io_uring_register_buffers_sparse", false);
+        regions.reserve(options.max_regions);
+        try {
+            grow();
+        } catch (...) {
+            io_uring_unregister_buffers(&ring);
+            throw;
+        }
+    }
+
+    /** Unregister the buffer table and free the memory
+     * @warning every slice must be given back, and no request may still use them
+     */
+    ~fixed_buffer_pool() noexcept {
+        assert(free_slices.size() == regions.size() * options.slices_per_region && "fixed_buffer_pool is destructed while slices are in use");
+        io_uring_unregister_buffers(ring);
+        for (auto& r : regions) {
+            ::munmap(r.base, r.length);
+        }
+    }
+
+    fixed_buffer_pool(const fixed_buffer_pool&) = delete;
+    fixed_buffer_pool& operator =(const fixed_buffer_pool&) = delete;
+
+    /** Take a slice, growing the pool if none is free
+     * @throw std::system_error with ENOBUFS if the pool can't grow anymore
+     */
+    fixed_buffer acquire() {
+        if (free_slices.empty() && !grow()) panic("fixed_buffer_pool::acquire", ENOBUFS);
+        return take();
+    }
+
+    /** Take a slice without growing the pool
+     * @return an empty fixed_buffer if none is free
+     */
+    fixed_buffer try_acquire() noexcept {
+        if (free_slices.empty()) return {};
+        return take();
+    }
+
+    /** Register a new region
+     * @see io_uring_register(2) IORING_REGISTER_BUFFERS_UPDATE
+     * @return false if `max_regions` is reached
+     * @throw std::system_error if allocating or registering memory fails
+     */
+    bool grow() {
+        if (regions.size() == options.max_regions) return false;
+
+        size_t length = options.slice_size * options.slices_per_region;
+        void* base = MAP_FAILED;
+        if (options.huge_pages) {
+            constexpr size_t huge_page_size = 2 << 20;
+            size_t huge_length = (length + huge_page_size - 1) & ~(huge_page_size - 1);
+            base = ::mmap(nullptr, huge_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (base != MAP_FAILED) length = huge_length;
+        }
+        if (base == MAP_FAILED) {
+            base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (base == MAP_FAILED) panic("mmap", errno);
+        }
+
+        auto index = unsigned(regions.size());
+        iovec iov = to_iov(base, options.slice_size * options.slices_per_region);
+        __u64 tag = 0;
+        int ret = io_uring_register_buffers_update_tag(ring, index, &iov, &tag, 1);
+        if (ret < 0) {
+            ::munmap(base, length);
+            panic("io_uring_register_buffers_update_tag", -ret);
+        }
+        regions.push_back({ base, length });
+
+        // Hand lower addresses out first
+        free_slices.reserve(regions.size() * options.slices_per_region);
+        for (size_t i = options.slices_per_region; i > 0; --i) {
+            free_slices.push_back({ static_cast<char *>(base) + (i - 1) * options.slice_size, uint16_t(index) });
+        }
+        return true;
+    }
+
+    /** Size of each slice */
+    size_t slice_size() const noexcept {
+        return options.slice_size;
+    }
+
+    /** Number of free slices */
+    size_t available() const noexcept {
+        return free_slices.size();
+    }
+
+    /** Number of regions registered */
+    size_t region_count() const noexcept {
+        return regions.size();
+    }
+
+private:
+    friend class fixed_buffer;
+
+    struct region {
+        void* base;
+        size_t length;
+    };
+
+    struct slice {
+        char* ptr;
+        uint16_t index;
+    };
+
+    fixed_buffer take() noexcept {
+        auto s = free_slices.back();
+        free_slices.pop_back();
+        return fixed_buffer(*this, s.ptr, s.index);
+    }
+
+    void give_back(char* ptr, uint16_t index) noexcept {
+        // Never reallocates, capacity is reserved for every slice when growing
+        free_slices.push_back({ ptr, index });
+    }
+
+    io_uring* ring;
+    fixed_buffer_pool_options options;
+    std::vector<region> regions;
+    // LIFO, so that recently used slices, likely still in cache, are reused first
+    std::vector<slice> free_slices;
+};
+
+inline size_t fixed_buffer::size() const noexcept {
+    return pool ? pool->slice_size() : 0;
+}
+
+inline void fixed_buffer::release() noexcept {
+    if (pool) std::exchange(pool, nullptr)->give_back(ptr, index);
+}
+
+} // namespace uio
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cassert>
+#include <cerrno>
+#include <vector>
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+/**
+ * A sparse file table registered to an io_service, managing its slots
+ * The first `reserved` slots are handed out by `install` for fds opened elsewhere,
+ * e.g. a listening socket. The others are allocated by the kernel for requests
+ * installing their result directly ( accept_direct, openat_direct, socket_direct ),
+ * and freed when the direct descriptor is closed
+ * @see io_uring_register(2) IORING_REGISTER_FILES IORING_RSRC_REGISTER_SPARSE
+ * @note like io_service, it's NOT thread safe
+ */
+class fixed_file_table {
+public:
+    /** Register a sparse file table
+     * @param service io_service to register the table to, which must outlive the table
+     * @param size number of slots
+     * @param reserved number of slots managed by `install`, at the start of the table
+     * @throw std::system_error if registering fails, e.g. a file table is registered already
+     */
+    fixed_file_table(io_service& service, unsigned size, unsigned reserved = 0)
+        : ring(&service.get_handle())
+        , size_(size)
+        , reserved(reserved) {
+        assert(reserved <= size && "more reserved slots than the table has");
+        io_uring_register_files_sparse(ring, size) | panic_on_err("io_uring_register_files_sparse", false);
+        if (reserved) {
+            // Keep the kernel from allocating the slots handed out by install. The range is
+            // empty if every slot is reserved, then requests installing their result directly
+            // fail with -ENFILE. Older kernels lack the call, and allocate from the whole table
+            int ret = io_uring_register_file_alloc_range(ring, reserved, size - reserved);
+            if (ret < 0 && ret != -EINVAL) {
+                io_uring_unregister_files(ring);
+                panic("io_uring_register_file_alloc_range", -ret);
+            }
+        }
+        free_slots.reserve(reserved);
+        for (unsigned i = reserved; i > 0; --i) {
+            free_slots.push_back(i - 1);
+        }
+    }
+
+    /** Unregister the table, closing every direct descriptor left */
+    ~fixed_file_table() noexcept {
+        io_uring_unregister_files(ring);
+    }
+
+    fixed_file_table(const fixed_file_table&) = delete;
+    fixed_file_table& operator =(const fixed_file_table&) = delete;
+
+    /** Number of slots */
+    unsigned size() const noexcept {
+        return size_;
+    }
+
+    /** Number of reserved slots not handed out by `install` */
+    unsigned available() const noexcept {
+        return unsigned(free_slots.size());
+    }
+
+    /** Install `fd` into a reserved slot
+     * The table holds its own reference to the file, `fd` may be closed afterwards
+     * @see io_uring_register(2) IORING_REGISTER_FILES_UPDATE
+     * @throw std::system_error with ENFILE if no reserved slot is free
+     */
+    fixed_fd install(int fd) {
+        if (free_slots.empty()) panic("fixed_file_table::install", ENFILE);
+        unsigned index = free_slots.back();
+        int ret = io_uring_register_files_update(ring, index, &fd, 1);
+        if (ret < 0) panic("io_uring_register_files_update", -ret);
+        free_slots.pop_back();
+        return fixed_fd(index);
+    }
+
+    /** Remove a direct descriptor from the table, freeing its slot
+     * Requests already issued on it keep their reference to the file. To remove it
+     * asynchronously instead, use io_service::close(fixed_fd)
+     * @note slots from `install` must be removed by this, so that they can be reused
+     */
+    void remove(fixed_fd fd) noexcept {
+        assert(fd.index() < size_ && "direct descriptor out of the table");
+        int closed = -1;
+        io_uring_register_files_update(ring, fd.index(), &closed, 1);
+        if (fd.index() < reserved) free_slots.push_back(fd.index());
+    }
+
+private:
+    io_uring* ring;
+    unsigned size_;
+    unsigned reserved;
+    // Reserved slots not handed out, lowest index last
+    std::vector<unsigned> free_slots;
+};
+
+} // namespace uio
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace uio {
+/** Interface of allocators for coroutine frames of uio::task
+ * @see set_frame_allocator
+ */
+struct frame_allocator {
+    virtual void* allocate(size_t size) = 0;
+    virtual void deallocate(void* ptr, size_t size) noexcept = 0;
+
+protected:
+    ~frame_allocator() = default;
+};
+
+/**
+ * Default frame allocator: thread local free lists of blocks, one per size class
+ * Freed frames are kept for reuse, so steady state allocation never reaches malloc.
+ * @note Blocks are allocated one by one rather than carved from slabs, so that a
+ *       frame may be freed by another thread than the one creating it; the block
+ *       then joins the free list of the freeing thread
+ */
+class frame_pool final: public frame_allocator {
+public:
+    static constexpr size_t granularity = 64;
+    static constexpr size_t class_count = 32; // Frames larger than 2 KiB aren't pooled
+    static constexpr size_t max_cached = 256; // Per size class
+
+    frame_pool() = default;
+    frame_pool(const frame_pool&) = delete;
+    frame_pool& operator =(const frame_pool&) = delete;
+
+    ~frame_pool() {
+        for (auto* head : free_lists) {
+            while (head) {
+                ::operator delete(std::exchange(head, head->next));
+            }
+        }
+    }
+
+    void* allocate(size_t size) override {
+        size_t cls = (size - 1) / granularity;
+        if (__builtin_expect(cls >= class_count, false)) return ::operator new(size);
+
+        if (auto* head = free_lists[cls]) {
+            free_lists[cls] = head->next;
+            --cached[cls];
+            return head;
+        }
+        return ::operator new((cls + 1) * granularity);
+    }
+
+    void deallocate(void* ptr, size_t size) noexcept override {
+        size_t cls = (size - 1) / granularity;
+        if (cls >= class_count || cached[cls] >= max_cached) {
+            ::operator delete(ptr);
+            return;
+        }
+        free_lists[cls] = new (ptr) block { free_lists[cls] };
+        ++cached[cls];
+    }
+
+    /** The pool of current thread */
+    static frame_pool& local() noexcept {
+        thread_local frame_pool pool;
+        return pool;
+    }
+
+private:
+    struct block {
+        block* next;
+    };
+
+    std::array<block*, class_count> free_lists {};
+    std::array<size_t, class_count> cached {};
+};
+
+/** Frame counters of a thread
+ * @note frames freed by another thread than the creating one are counted there,
+ *       so `live` of a single thread may be negative
+ */
+struct frame_stats {
+    ptrdiff_t live = 0;
+    ptrdiff_t peak = 0;
+};
+
+namespace frame_local {
+inline frame_allocator*& allocator() noexcept {
+    thread_local frame_allocator* allocator = nullptr;
+    return allocator;
+}
+
+inline frame_stats& stats() noexcept {
+    thread_local frame_stats stats;
+    return stats;
+}
+
+// Each frame is prefixed with the allocator creating it, nullptr for frame_pool
+constexpr size_t header_size = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+} // namespace frame_local
+
+/** Use `allocator` for frames of tasks created by current thread afterwards
+ * @param allocator custom allocator, which must outlive every frame allocated by it;
+ *        nullptr restores the default frame_pool
+ */
+inline void set_frame_allocator(frame_allocator* allocator) noexcept {
+    frame_local::allocator() = allocator;
+}
+
+/** Get frame counters of current thread */
+inline frame_stats get_frame_stats() noexcept {
+    return frame_local::stats();
+}
+
+inline void* allocate_frame(size_t size) {
+    auto* allocator = frame_local::allocator();
+    auto* p = static_cast<std::byte *>(allocator
+        ? allocator->allocate(size + frame_local::header_size)
+        : frame_pool::local().allocate(size + frame_local::header_size));
+    *reinterpret_cast<frame_allocator **>(p) = allocator;
+
+    auto& stats = frame_local::stats();
+    stats.peak = std::max(stats.peak, ++stats.live);
+    return p + frame_local::header_size;
+}
+
+inline void deallocate_frame(void* ptr, size_t size) noexcept {
+    auto* p = static_cast<std::byte *>(ptr) - frame_local::header_size;
+    auto* allocator = *reinterpret_cast<frame_allocator **>(p);
+
+    --frame_local::stats().live;
+    if (allocator) {
+        allocator->deallocate(p, size + frame_local::header_size);
+    } else {
+        frame_pool::local().deallocate(p, size + frame_local::header_size);
+    }
+}
+
+} // namespace uio
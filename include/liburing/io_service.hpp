@@ -1,4 +1,5 @@
 #pragma once
+#include <deque>
 #include <functional>
 #include <system_error>
 #include <chrono>
@@ -15,6 +16,11 @@
 #include <liburing/sqe_awaitable.hpp>
 #include <liburing/task.hpp>
 #include <liburing/utils.hpp>
+#include <liburing/buffer_ring.hpp>
+#include <liburing/fixed_buffer_pool.hpp>
+#include <liburing/timer_wheel.hpp>
+#include <liburing/multishot_awaitable.hpp>
+#include <liburing/zc_awaitable.hpp>
 
 #ifdef LIBURING_VERBOSE
 #   define puts_if_verbose(x) puts(x)
@@ -25,33 +31,168 @@
 #endif
 
 namespace uio {
+/** Setup options of io_service
+ * @see io_uring_setup(2)
+ * @note Optional modes ( single_issuer, defer_taskrun, coop_taskrun ) are enabled only
+ *       if current kernel supports them. Check io_service::setup_flags for the result
+ */
+struct io_service_options {
+    /** Size of the SQ ring. More sqes gotten between two submissions are staged in userspace */
+    unsigned entries = 64;
+    /** Size of the CQ ring ( IORING_SETUP_CQSIZE ), 0 for twice `entries` */
+    unsigned cq_entries = 0;
+    /** Extra raw IORING_SETUP_* flags, which must be supported */
+    uint32_t flags = 0;
+    /** Existing io_uring ring_fd to share the async worker pool with ( IORING_SETUP_ATTACH_WQ ), 0 for none */
+    uint32_t wq_fd = 0;
+    /** Only the thread creating the ring submits to it ( IORING_SETUP_SINGLE_ISSUER, Linux 6.0 ) */
+    bool single_issuer = false;
+    /** Run completion task work only when the ring is entered for events, instead of
+     * interrupting the thread ( IORING_SETUP_DEFER_TASKRUN, Linux 6.1 ). Implies single_issuer
+     */
+    bool defer_taskrun = false;
+    /** Don't interrupt the thread with an IPI to run completion task work
+     * ( IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG, Linux 5.19 )
+     */
+    bool coop_taskrun = false;
+    /** Let a kernel thread poll the SQ ring, so that submitting needs no syscall while
+     * it's awake ( IORING_SETUP_SQPOLL ). Task run modes above are ignored with it
+     */
+    bool sqpoll = false;
+    /** CPU the SQ poll thread is bound to ( IORING_SETUP_SQ_AFF ), -1 for none */
+    int sq_thread_cpu = -1;
+    /** Milliseconds the SQ poll thread spins without work before sleeping, 0 for kernel default ( 1s ) */
+    unsigned sq_thread_idle = 0;
+    /** How long `run` busy polls the CQ ring before blocking for a completion, 0 to always block
+     * Trades a core for the latency of sleeping and waking up, when completions come within microseconds
+     */
+    std::chrono::nanoseconds spin_budget = std::chrono::nanoseconds::zero();
+    /** Spin up to twice the recent average wait, within `spin_budget`, and not at all while
+     * completions come slower than the budget
+     */
+    bool adaptive_spin = false;
+    /** Maximum number of coroutines resumed per loop iteration, 0 for no limit
+     * Completions, expired sleeps and callbacks are queued by priority ( see resume_priority ),
+     * and those over budget are resumed by the next iterations, which don't block meanwhile
+     */
+    unsigned resume_budget = 0;
+};
+
+/** A direct descriptor, i.e. an index into the file table registered to an io_service
+ * Operations taking it set IOSQE_FIXED_FILE themselves, so the kernel skips looking
+ * up and refcounting the file per request
+ * @see fixed_file_table
+ */
+class fixed_fd {
+public:
+    constexpr explicit fixed_fd(unsigned index) noexcept: index_(index) {}
+
+    /** Index in the registered file table */
+    constexpr unsigned index() const noexcept {
+        return index_;
+    }
+
+    friend constexpr bool operator ==(fixed_fd, fixed_fd) noexcept = default;
+
+private:
+    unsigned index_;
+};
+
+/** Hooks letting a scheduler run its own ready work inside io_service::run, see runtime */
+struct run_scheduler {
+    /** Run ready work, called before each batch of cqes is reaped
+     * @return whether any work was run, in which case run doesn't block for cqes
+     */
+    virtual bool run_ready() noexcept = 0;
+
+    /** Called right before run blocks for cqes
+     * @return false to reap cqes without blocking instead, e.g. work became ready meanwhile
+     */
+    virtual bool before_wait() noexcept = 0;
+
+    /** Called once run wakes up from blocking */
+    virtual void after_wait() noexcept = 0;
+
+protected:
+    ~run_scheduler() = default;
+};
+
 class io_service {
 public:
     /** Init io_service / io_uring object
      * @see io_uring_setup(2)
-     * @param entries Maximum sqe can be gotten without submitting
+     * @param entries Size of the SQ ring, more sqes are staged until submitted
      * @param flags flags used to init io_uring
      * @param wq_fd existing io_uring ring_fd used by IORING_SETUP_ATTACH_WQ
      * @note io_service is NOT thread safe, nor is liburing. When used in a
      *       multi-threaded program, it's highly recommended to create
      *       io_service/io_uring instance per thread, and set IORING_SETUP_ATTACH_WQ
      *       flag to make sure that kernel shares the only async worker thread pool.
-     *       See `IORING_SETUP_ATTACH_WQ` for detail.
+     *       See `IORING_SETUP_ATTACH_WQ` for detail, and runtime.hpp which does so.
      */
-    io_service(int entries = 64, uint32_t flags = 0, uint32_t wq_fd = 0) {
-        io_uring_params p = {
+    io_service(int entries = 64, uint32_t flags = 0, uint32_t wq_fd = 0)
+        : io_service(io_service_options {
+            .entries = unsigned(entries),
             .flags = flags,
             .wq_fd = wq_fd,
-        };
+        }) {}
 
-        io_uring_queue_init_params(entries, &ring, &p) | panic_on_err("queue_init_params", false);
+    /** Init io_service / io_uring object with optional setup modes
+     * @see io_uring_setup(2)
+     * @see io_service_options
+     * @note Modes unsupported by current kernel are dropped one by one, newest first,
+     *       until io_uring_setup accepts the flags. See `setup_flags` for what is in effect
+     */
+    explicit io_service(const io_service_options& options)
+        : spin_budget(options.spin_budget)
+        , spin_average(options.spin_budget / 2)
+        , adaptive_spin(options.adaptive_spin)
+        , resume_budget(options.resume_budget) {
+        uint32_t optional = 0;
+        if (options.defer_taskrun) {
+            optional |= IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+        }
+        if (options.single_issuer) optional |= IORING_SETUP_SINGLE_ISSUER;
+        if (options.coop_taskrun) optional |= IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+        if (options.sqpoll) {
+            // Completions are handled by the poller thread, there's no IPI to avoid
+            optional &= ~(IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG);
+        }
+
+        io_uring_params p;
+        for (;;) {
+            p = {
+                .cq_entries = options.cq_entries,
+                .flags = options.flags | optional,
+                .wq_fd = options.wq_fd,
+            };
+            if (options.cq_entries) p.flags |= IORING_SETUP_CQSIZE;
+            if (options.wq_fd) p.flags |= IORING_SETUP_ATTACH_WQ;
+            if (options.sqpoll) {
+                p.flags |= IORING_SETUP_SQPOLL;
+                p.sq_thread_idle = options.sq_thread_idle;
+                if (options.sq_thread_cpu >= 0) {
+                    p.flags |= IORING_SETUP_SQ_AFF;
+                    p.sq_thread_cpu = uint32_t(options.sq_thread_cpu);
+                }
+            }
+
+            int ret = io_uring_queue_init_params(options.entries, &ring, &p);
+            if (ret == -EINVAL && optional) {
+                optional = drop_newest_mode(optional);
+                continue;
+            }
+            ret | panic_on_err("queue_init_params", false);
+            break;
+        }
+        flags_ = p.flags;
 
         auto* probe = io_uring_get_probe_ring(&ring);
         on_scope_exit free_probe([=]() { io_uring_free_probe(probe); });
 #define TEST_IORING_OP(opcode) do {\
     for (int i = 0; i < probe->ops_len; ++i) {\
         if (probe->ops[i].op == opcode && probe->ops[i].flags & IO_URING_OP_SUPPORTED) {\
-                probe_ops[i] = true;\
+                probe_ops[opcode] = true;\
                 puts_if_verbose("\t" #opcode);\
                 break;\
             }\
@@ -98,6 +239,10 @@ public:
     TEST_IORING_OP(IORING_OP_MKDIRAT);
     TEST_IORING_OP(IORING_OP_SYMLINKAT);
     TEST_IORING_OP(IORING_OP_LINKAT);
+    TEST_IORING_OP(IORING_OP_MSG_RING);
+    TEST_IORING_OP(IORING_OP_SOCKET);
+    TEST_IORING_OP(IORING_OP_SEND_ZC);
+    TEST_IORING_OP(IORING_OP_SENDMSG_ZC);
 #undef TEST_IORING_OP
 
 #define TEST_IORING_FEATURE(feature) if (p.features & feature) puts_if_verbose("\t" #feature)
@@ -113,7 +258,10 @@ public:
     TEST_IORING_FEATURE(IORING_FEAT_EXT_ARG);
     TEST_IORING_FEATURE(IORING_FEAT_NATIVE_WORKERS);
     TEST_IORING_FEATURE(IORING_FEAT_RSRC_TAGS);
+    TEST_IORING_FEATURE(IORING_FEAT_CQE_SKIP);
+    TEST_IORING_FEATURE(IORING_FEAT_LINKED_FILE);
 #undef TEST_IORING_FEATURE
+    features_ = p.features;
     }
 
     /** Destroy io_service / io_uring object */
@@ -181,6 +329,24 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Read from a file descriptor into a buffer picked by kernel asynchronously
+     * @see pread(2)
+     * @see io_uring_enter(2) IORING_OP_READ IOSQE_BUFFER_SELECT
+     * @param ring provided buffers to select from
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved with a buffer_lease
+     */
+    buffer_awaitable read(
+        int fd,
+        buffer_ring& ring,
+        off_t offset,
+        uint8_t iflags = 0
+    ) {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_read(sqe, fd, nullptr, ring.buffer_size(), offset);
+        return await_buffer(sqe, ring, iflags);
+    }
+
     /** Write to a file descriptor at a given offset asynchronously
      * @see pwrite(2)
      * @see io_uring_enter(2) IORING_OP_WRITE
@@ -239,6 +405,35 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Read data into a slice of a fixed_buffer_pool asynchronously, up to its size
+     * @see io_uring_enter(2) IORING_OP_READ_FIXED
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting
+     */
+    sqe_awaitable read_fixed(
+        int fd,
+        fixed_buffer& buf,
+        off_t offset,
+        uint8_t iflags = 0
+    ) noexcept {
+        return read_fixed(fd, buf.data(), unsigned(buf.size()), offset, buf.buf_index(), iflags);
+    }
+
+    /** Write the first `nbytes` of a slice of a fixed_buffer_pool asynchronously, no more than its size
+     * @see io_uring_enter(2) IORING_OP_WRITE_FIXED
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting
+     */
+    sqe_awaitable write_fixed(
+        int fd,
+        const fixed_buffer& buf,
+        unsigned nbytes,
+        off_t offset,
+        uint8_t iflags = 0
+    ) noexcept {
+        return write_fixed(fd, buf.data(), nbytes, offset, buf.buf_index(), iflags);
+    }
+
     /** Synchronize a file's in-core state with storage device asynchronously
      * @see fsync(2)
      * @see io_uring_enter(2) IORING_OP_FSYNC
@@ -327,6 +522,44 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Receive a message from a socket into a buffer picked by kernel asynchronously
+     * @see recv(2)
+     * @see io_uring_enter(2) IORING_OP_RECV IOSQE_BUFFER_SELECT
+     * @param ring provided buffers to select from
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved with a buffer_lease
+     */
+    buffer_awaitable recv(
+        int sockfd,
+        buffer_ring& ring,
+        uint32_t flags,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_recv(sqe, sockfd, nullptr, ring.buffer_size(), flags);
+        return await_buffer(sqe, ring, iflags);
+    }
+
+    /** Receive messages from a socket into buffers picked by kernel, using only one sqe
+     * @see recv(2)
+     * @see io_uring_enter(2) IORING_OP_RECV IORING_RECV_MULTISHOT IOSQE_BUFFER_SELECT
+     * @param ring provided buffers to select from
+     * @param iflags IOSQE_* flags
+     * @return a stream object producing buffer_leases until EOF, error or cancelled
+     * @note the request is issued again if the kernel stops it for lack of buffers (ENOBUFS)
+     */
+    multishot_buffer_awaitable recv_multishot(
+        int sockfd,
+        buffer_ring& ring,
+        uint32_t flags,
+        uint8_t iflags = 0
+    ) {
+        auto* resolver = new recv_multishot_resolver(*this, ring, sockfd, flags, iflags);
+        auto* sqe = io_uring_get_sqe_safe();
+        resolver->prepare(sqe);
+        return multishot_buffer_awaitable(*this, sqe, resolver, ring);
+    }
+
     /** Send a message on a socket asynchronously
      * @see send(2)
      * @see io_uring_enter(2) IORING_OP_SEND
@@ -345,6 +578,43 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Send a message on a socket without copying the buffer asynchronously
+     * @see send(2)
+     * @see io_uring_enter(2) IORING_OP_SEND_ZC
+     * @param iflags IOSQE_* flags
+     * @return an object for awaiting the result, and then the release of `buf`
+     */
+    zc_awaitable send_zc(
+        int sockfd,
+        const void* buf,
+        unsigned nbytes,
+        uint32_t flags,
+        uint8_t iflags = 0
+    ) {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_send_zc(sqe, sockfd, buf, nbytes, flags, 0);
+        io_uring_sqe_set_flags(sqe, iflags);
+        return zc_awaitable(sqe);
+    }
+
+    /** Send a message on a socket without copying buffers asynchronously
+     * @see sendmsg(2)
+     * @see io_uring_enter(2) IORING_OP_SENDMSG_ZC
+     * @param iflags IOSQE_* flags
+     * @return an object for awaiting the result, and then the release of `msg` buffers
+     */
+    zc_awaitable sendmsg_zc(
+        int sockfd,
+        const msghdr* msg,
+        uint32_t flags,
+        uint8_t iflags = 0
+    ) {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_sendmsg_zc(sqe, sockfd, msg, flags);
+        io_uring_sqe_set_flags(sqe, iflags);
+        return zc_awaitable(sqe);
+    }
+
     /** Wait for an event on a file descriptor asynchronously
      * @see poll(2)
      * @see io_uring_enter(2)
@@ -392,6 +662,25 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Accept connections on a socket asynchronously, using only one sqe
+     * @see accept4(2)
+     * @see io_uring_enter(2) IORING_OP_ACCEPT IORING_ACCEPT_MULTISHOT
+     * @param iflags IOSQE_* flags
+     * @return a stream object producing accepted fds until cancelled
+     */
+    multishot_awaitable accept_multishot(
+        int fd,
+        sockaddr *addr,
+        socklen_t *addrlen,
+        int flags = 0,
+        uint8_t iflags = 0
+    ) {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_multishot_accept(sqe, fd, addr, addrlen, flags);
+        io_uring_sqe_set_flags(sqe, iflags);
+        return multishot_awaitable(*this, sqe, new accept_resolver());
+    }
+
     /** Initiate a connection on a socket asynchronously
      * @see connect(2)
      * @see io_uring_enter(2) IORING_OP_CONNECT
@@ -425,6 +714,23 @@ public:
         return await_work(sqe, iflags);
     }
 
+    /** Suspend the awaiting coroutine for `dur`
+     * Unlike `timeout`, no request is issued per call. Sleeps are timers of a userspace
+     * timer wheel driven by `run`, which bounds its wait for cqes by the next deadline
+     * @see timer_wheel
+     * @return an awaitable resolved once `dur` has elapsed
+     */
+    auto sleep_for(std::chrono::nanoseconds dur) noexcept {
+        return timers.sleep_until(timer_wheel::clock::now() + dur);
+    }
+
+    /** Suspend the awaiting coroutine until `deadline`
+     * @see sleep_for
+     */
+    auto sleep_until(timer_wheel::clock::time_point deadline) noexcept {
+        return timers.sleep_until(deadline);
+    }
+
     /** Open and possibly create a file asynchronously
      * @see openat(2)
      * @see io_uring_enter(2) IORING_OP_OPENAT
@@ -620,34 +926,329 @@ public:
         return await_work(sqe, iflags);
     }
 
+public:
+    /** Read from a direct descriptor at a given offset asynchronously
+     * @see read(int, void*, unsigned, off_t, uint8_t)
+     */
+    sqe_awaitable read(fixed_fd fd, void* buf, unsigned nbytes, off_t offset, uint8_t iflags = 0) {
+        return read(int(fd.index()), buf, nbytes, offset, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Read from a direct descriptor into a buffer picked by kernel asynchronously
+     * @see read(int, buffer_ring&, off_t, uint8_t)
+     */
+    buffer_awaitable read(fixed_fd fd, buffer_ring& ring, off_t offset, uint8_t iflags = 0) {
+        return read(int(fd.index()), ring, offset, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Write to a direct descriptor at a given offset asynchronously
+     * @see write(int, const void*, unsigned, off_t, uint8_t)
+     */
+    sqe_awaitable write(fixed_fd fd, const void* buf, unsigned nbytes, off_t offset, uint8_t iflags = 0) {
+        return write(int(fd.index()), buf, nbytes, offset, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Read data from a direct descriptor into multiple buffers asynchronously
+     * @see readv(int, const iovec*, unsigned, off_t, uint8_t)
+     */
+    sqe_awaitable readv(fixed_fd fd, const iovec* iovecs, unsigned nr_vecs, off_t offset, uint8_t iflags = 0) noexcept {
+        return readv(int(fd.index()), iovecs, nr_vecs, offset, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Write data from multiple buffers to a direct descriptor asynchronously
+     * @see writev(int, const iovec*, unsigned, off_t, uint8_t)
+     */
+    sqe_awaitable writev(fixed_fd fd, const iovec* iovecs, unsigned nr_vecs, off_t offset, uint8_t iflags = 0) noexcept {
+        return writev(int(fd.index()), iovecs, nr_vecs, offset, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Read data from a direct descriptor into a fixed buffer asynchronously
+     * @see read_fixed(int, void*, unsigned, off_t, int, uint8_t)
+     */
+    sqe_awaitable read_fixed(fixed_fd fd, void* buf, unsigned nbytes, off_t offset, int buf_index, uint8_t iflags = 0) noexcept {
+        return read_fixed(int(fd.index()), buf, nbytes, offset, buf_index, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Write data from a fixed buffer to a direct descriptor asynchronously
+     * @see write_fixed(int, const void*, unsigned, off_t, int, uint8_t)
+     */
+    sqe_awaitable write_fixed(fixed_fd fd, const void* buf, unsigned nbytes, off_t offset, int buf_index, uint8_t iflags = 0) noexcept {
+        return write_fixed(int(fd.index()), buf, nbytes, offset, buf_index, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Read data from a direct descriptor into a slice of a fixed_buffer_pool asynchronously
+     * @see read_fixed(int, fixed_buffer&, off_t, uint8_t)
+     */
+    sqe_awaitable read_fixed(fixed_fd fd, fixed_buffer& buf, off_t offset, uint8_t iflags = 0) noexcept {
+        return read_fixed(int(fd.index()), buf, offset, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Write a slice of a fixed_buffer_pool to a direct descriptor asynchronously
+     * @see write_fixed(int, const fixed_buffer&, unsigned, off_t, uint8_t)
+     */
+    sqe_awaitable write_fixed(fixed_fd fd, const fixed_buffer& buf, unsigned nbytes, off_t offset, uint8_t iflags = 0) noexcept {
+        return write_fixed(int(fd.index()), buf, nbytes, offset, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Synchronize the file of a direct descriptor with storage device asynchronously
+     * @see fsync(int, unsigned, uint8_t)
+     */
+    sqe_awaitable fsync(fixed_fd fd, unsigned fsync_flags, uint8_t iflags = 0) noexcept {
+        return fsync(int(fd.index()), fsync_flags, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Receive a message from a direct socket asynchronously
+     * @see recvmsg(int, msghdr*, uint32_t, uint8_t)
+     */
+    sqe_awaitable recvmsg(fixed_fd sockfd, msghdr* msg, uint32_t flags, uint8_t iflags = 0) noexcept {
+        return recvmsg(int(sockfd.index()), msg, flags, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Send a message on a direct socket asynchronously
+     * @see sendmsg(int, const msghdr*, uint32_t, uint8_t)
+     */
+    sqe_awaitable sendmsg(fixed_fd sockfd, const msghdr* msg, uint32_t flags, uint8_t iflags = 0) noexcept {
+        return sendmsg(int(sockfd.index()), msg, flags, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Receive a message from a direct socket asynchronously
+     * @see recv(int, void*, unsigned, uint32_t, uint8_t)
+     */
+    sqe_awaitable recv(fixed_fd sockfd, void* buf, unsigned nbytes, uint32_t flags, uint8_t iflags = 0) noexcept {
+        return recv(int(sockfd.index()), buf, nbytes, flags, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Receive a message from a direct socket into a buffer picked by kernel asynchronously
+     * @see recv(int, buffer_ring&, uint32_t, uint8_t)
+     */
+    buffer_awaitable recv(fixed_fd sockfd, buffer_ring& ring, uint32_t flags, uint8_t iflags = 0) noexcept {
+        return recv(int(sockfd.index()), ring, flags, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Send a message on a direct socket asynchronously
+     * @see send(int, const void*, unsigned, uint32_t, uint8_t)
+     */
+    sqe_awaitable send(fixed_fd sockfd, const void* buf, unsigned nbytes, uint32_t flags, uint8_t iflags = 0) noexcept {
+        return send(int(sockfd.index()), buf, nbytes, flags, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Accept a connection on a direct socket asynchronously
+     * @see accept(int, sockaddr*, socklen_t*, int, uint8_t)
+     */
+    sqe_awaitable accept(fixed_fd fd, sockaddr *addr, socklen_t *addrlen, int flags = 0, uint8_t iflags = 0) noexcept {
+        return accept(int(fd.index()), addr, addrlen, flags, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Initiate a connection on a direct socket asynchronously
+     * @see connect(int, sockaddr*, socklen_t, int, uint8_t)
+     */
+    sqe_awaitable connect(fixed_fd fd, sockaddr *addr, socklen_t addrlen, int flags = 0, uint8_t iflags = 0) noexcept {
+        return connect(int(fd.index()), addr, addrlen, flags, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Shut down part of a full-duplex connection of a direct socket asynchronously
+     * @see shutdown(int, int, uint8_t)
+     */
+    sqe_awaitable shutdown(fixed_fd fd, int how, uint8_t iflags = 0) {
+        return shutdown(int(fd.index()), how, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Close a direct descriptor asynchronously, freeing its slot in the file table
+     * @see io_uring_enter(2) IORING_OP_CLOSE
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting
+     */
+    sqe_awaitable close(
+        fixed_fd fd,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_close_direct(sqe, fd.index());
+        return await_work(sqe, iflags);
+    }
+
+    /** Accept a connection on a socket into a free slot of the file table asynchronously
+     * @see accept4(2)
+     * @see io_uring_enter(2) IORING_OP_ACCEPT IORING_FILE_INDEX_ALLOC
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved with the index of the accepted
+     *         direct descriptor ( see fixed_fd ), or -ENFILE if the table is full
+     */
+    sqe_awaitable accept_direct(
+        int fd,
+        sockaddr *addr,
+        socklen_t *addrlen,
+        int flags = 0,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_accept_direct(sqe, fd, addr, addrlen, flags, IORING_FILE_INDEX_ALLOC);
+        return await_work(sqe, iflags);
+    }
+    sqe_awaitable accept_direct(fixed_fd fd, sockaddr *addr, socklen_t *addrlen, int flags = 0, uint8_t iflags = 0) noexcept {
+        return accept_direct(int(fd.index()), addr, addrlen, flags, iflags | IOSQE_FIXED_FILE);
+    }
+
+    /** Open and possibly create a file into a free slot of the file table asynchronously
+     * @see openat(2)
+     * @see io_uring_enter(2) IORING_OP_OPENAT IORING_FILE_INDEX_ALLOC
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved with the index of the opened
+     *         direct descriptor ( see fixed_fd ), or -ENFILE if the table is full
+     */
+    sqe_awaitable openat_direct(
+        int dfd,
+        const char *path,
+        int flags,
+        mode_t mode,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_openat_direct(sqe, dfd, path, flags, mode, IORING_FILE_INDEX_ALLOC);
+        return await_work(sqe, iflags);
+    }
+
+    /** Create a socket into a free slot of the file table asynchronously
+     * @see socket(2)
+     * @see io_uring_enter(2) IORING_OP_SOCKET IORING_FILE_INDEX_ALLOC
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved with the index of the created
+     *         direct descriptor ( see fixed_fd ), or -ENFILE if the table is full
+     */
+    sqe_awaitable socket_direct(
+        int domain,
+        int type,
+        int protocol,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_socket_direct_alloc(sqe, domain, type, protocol, 0);
+        return await_work(sqe, iflags);
+    }
+
+public:
+    /** Attempt to cancel an already issued request asynchronously
+     * @see io_uring_enter(2) IORING_OP_ASYNC_CANCEL
+     * @param user_data user_data of the request to cancel
+     * @param flags IORING_ASYNC_CANCEL_* flags
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting
+     */
+    sqe_awaitable cancel(
+        void* user_data,
+        int flags = 0,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_cancel(sqe, user_data, flags);
+        return await_work(sqe, iflags);
+    }
+
+    /** Call `fn` on the thread running `target`
+     * The message is delivered as an ordinary cqe of `target`, without any lock or eventfd
+     * @see io_uring_enter(2) IORING_OP_MSG_RING
+     * @param target io_service to call `fn`, maybe this one
+     * @param iflags IOSQE_* flags
+     * @note MUST be called by the thread running this io_service. `fn` is dropped if the
+     *       message can't be posted, e.g. MSG_RING isn't supported
+     */
+    void post(
+        io_service& target,
+        std::function<void ()> fn,
+        uint8_t iflags = 0
+    ) {
+        auto* sqe = io_uring_get_sqe_safe();
+        // Exactly one cqe refers to the callback: the message on success, or our own cqe on failure
+        auto* cb = new callback_resolver([fn = std::move(fn)] (int result) {
+            if (result >= 0) fn();
+        });
+        io_uring_prep_msg_ring(sqe, target.ring.ring_fd, 0, reinterpret_cast<uintptr_t>(cb->user_data()), 0);
+        io_uring_sqe_set_flags(sqe, iflags | IOSQE_CQE_SKIP_SUCCESS);
+        io_uring_sqe_set_data(sqe, cb->user_data());
+    }
+
+    /** Move the awaiting coroutine to the thread running `target`
+     * @see io_uring_enter(2) IORING_OP_MSG_RING
+     * @param target io_service to resume the coroutine, requests issued afterwards should go to it
+     * @param iflags IOSQE_* flags
+     * @return a task object for awaiting, resolved with 0 on `target`, or -errno on this
+     *         io_service if the coroutine can't be moved
+     */
+    schedule_awaitable schedule_on(
+        io_service& target,
+        uint8_t iflags = 0
+    ) noexcept {
+        auto* sqe = io_uring_get_sqe_safe();
+        io_uring_prep_msg_ring(sqe, target.ring.ring_fd, 0, 0, 0);
+        io_uring_sqe_set_flags(sqe, iflags | IOSQE_CQE_SKIP_SUCCESS);
+        return schedule_awaitable(sqe);
+    }
+
 private:
     sqe_awaitable await_work(
         io_uring_sqe* sqe,
         uint8_t iflags
     ) noexcept {
         io_uring_sqe_set_flags(sqe, iflags);
-        return sqe_awaitable(sqe);
+        return sqe_awaitable(sqe, this);
+    }
+
+    buffer_awaitable await_buffer(
+        io_uring_sqe* sqe,
+        buffer_ring& ring,
+        uint8_t iflags
+    ) noexcept {
+        io_uring_sqe_set_flags(sqe, iflags | IOSQE_BUFFER_SELECT);
+        sqe->buf_group = uint16_t(ring.group_id());
+        return buffer_awaitable(sqe, ring, this);
     }
 
 public:
     /** Get a sqe pointer that can never be NULL
-     * @param ring pointer to inited io_uring struct
-     * @return pointer to `io_uring_sqe` struct (not NULL)
+     * Nothing is submitted here: when the SQ is full, the sqe is staged in userspace, and so
+     * are the following ones, until `run` moves them into the SQ. If the last sqe of the SQ
+     * starts a link chain ( IOSQE_IO_LINK or IOSQE_IO_HARDLINK ), it's staged too, as a link
+     * chain can't cross a submission. Its user_data is cleared, so that the completion of a
+     * request nobody awaits is ignored
+     * @return pointer to `io_uring_sqe` struct (not NULL), valid until the next submission
      */
     [[nodiscard]]
     io_uring_sqe* io_uring_get_sqe_safe() noexcept {
-        auto* sqe = io_uring_get_sqe(&ring);
-        if (__builtin_expect(!!sqe, true)) {
-            return sqe;
-        } else {
-            printf_if_verbose(__FILE__ ": SQ is full, flushing %u cqe(s)\n", cqe_count);
-            io_uring_cq_advance(&ring, cqe_count);
-            cqe_count = 0;
-            io_uring_submit(&ring);
-            sqe = io_uring_get_sqe(&ring);
-            if (__builtin_expect(!!sqe, true)) return sqe;
-            panic("io_uring_get_sqe", ENOMEM);
+        if (__builtin_expect(staged.empty(), true)) {
+            if (auto* sqe = io_uring_get_sqe(&ring)) {
+                io_uring_sqe_set_data(sqe, nullptr);
+                return sq_last = sqe;
+            }
+            printf_if_verbose(__FILE__ ": SQ is full, staging sqes\n");
+            if (sq_last && (sq_last->flags & (IOSQE_IO_LINK | IOSQE_IO_HARDLINK))) stage_sq_last();
+        }
+        return &staged.emplace_back();
+    }
+
+    /** Get a sqe linked after `prev`, so that both reach the kernel in one io_uring_enter
+     * Like io_uring_get_sqe_safe, for a `prev` whose IOSQE_IO_LINK isn't set yet: if it took
+     * the last slot of the SQ, it's staged along with the new sqe
+     * @param prev the last sqe gotten, updated if it's moved. Its IOSQE_IO_LINK is left to the caller
+     * @return pointer to `io_uring_sqe` struct (not NULL), valid until the next submission
+     */
+    [[nodiscard]]
+    io_uring_sqe* io_uring_get_linked_sqe_safe(io_uring_sqe*& prev) noexcept {
+        if (staged.empty() && prev == sq_last && io_uring_sq_space_left(&ring) == 0) {
+            prev = stage_sq_last();
         }
+        return io_uring_get_sqe_safe();
+    }
+
+    /** Number of coroutines ( and callbacks ) woken up, waiting for the resume budget */
+    [[nodiscard]]
+    size_t ready_size() const noexcept {
+        return ready_count;
+    }
+
+    /** Number of sqes staged, waiting for room in the SQ */
+    [[nodiscard]]
+    size_t staged_count() const noexcept {
+        return staged.size();
     }
 
     /** Wait for an event forever, blocking
@@ -658,24 +1259,354 @@ public:
     template <typename T, bool nothrow>
     T run(const task<T, nothrow>& t) noexcept(nothrow) {
         while (!t.done()) {
-            io_uring_submit_and_wait(&ring, 1);
+            run_batch(true);
+        }
+
+        return t.get_result();
+    }
+
+    /** Submit pending sqes, wait for at least one cqe ( or an armed timer ), and handle every cqe available
+     * @return number of cqes handled
+     */
+    unsigned run_once() noexcept {
+        return run_batch(true);
+    }
+
+    /** Submit pending sqes, and handle every cqe available without waiting
+     * E.g. from another event loop, woken by the eventfd of `register_eventfd`
+     * @return number of cqes handled
+     */
+    unsigned poll() noexcept {
+        return run_batch(false);
+    }
+
+    /** Handle cqes until `dur` passes
+     * The wait is passed to io_uring_enter itself ( IORING_FEAT_EXT_ARG ), like timers
+     * @return number of cqes handled
+     */
+    size_t run_for(std::chrono::nanoseconds dur) noexcept {
+        return run_until(timer_wheel::clock::now() + dur);
+    }
+
+    /** Handle cqes until `deadline`
+     * @return number of cqes handled
+     */
+    size_t run_until(timer_wheel::clock::time_point deadline) noexcept {
+        size_t handled = 0;
+        while (timer_wheel::clock::now() < deadline) {
+            handled += run_batch(true, deadline);
+        }
+        return handled;
+    }
+
+    /** Handle cqes until `pred()` returns true, checked before each batch
+     * @return number of cqes handled
+     */
+    template <typename Pred>
+        requires std::is_invocable_r_v<bool, Pred&>
+    size_t run_until(Pred&& pred) noexcept(noexcept(pred())) {
+        size_t handled = 0;
+        while (!pred()) {
+            handled += run_batch(true);
+        }
+        return handled;
+    }
+
+private:
+    /** One iteration of the loop: submit, wait unless `wait` is false, then dispatch every cqe
+     * available and fire expired timers
+     * @param deadline latest time to wake up at, when waiting
+     * @return number of cqes handled
+     */
+    unsigned run_batch(bool wait, timer_wheel::clock::time_point deadline = timer_wheel::clock::time_point::max()) noexcept {
+        // Coroutines woken up from here on are queued, see schedule_ready. Restored for nested loops
+        auto* outer = std::exchange(dispatching(), this);
+        // Coroutines left over by the resume budget are resumed without blocking
+        if (ready_count) wait = false;
+        if (__builtin_expect(!!scheduler, false)) {
+            if (scheduler->run_ready() || io_uring_cq_ready(&ring) || !wait || !scheduler->before_wait()) {
+                reap_events(false);
+            } else {
+                reap_events(true, deadline);
+                scheduler->after_wait();
+            }
+        } else {
+            reap_events(wait, deadline);
+        }
 
+        // Only cqes there now are handled, so that a flood of them can't hold the loop
+        unsigned handled = io_uring_cq_ready(&ring);
+        printf_if_verbose(__FILE__ ": Found %u cqe(s), looping...\n", handled);
+        for (unsigned left = handled; left; ) {
+            // Copy cqes out and advance the CQ before running user code, so that the
+            // kernel can post more meanwhile
+            struct completion {
+                void* user_data;
+                int res;
+                uint32_t flags;
+            };
+            std::array<completion, 64> batch;
+            unsigned count = 0;
             io_uring_cqe *cqe;
             unsigned head;
-
             io_uring_for_each_cqe(&ring, head, cqe) {
-                ++cqe_count;
-                auto coro = static_cast<resolver *>(io_uring_cqe_get_data(cqe));
-                if (coro) coro->resolve(cqe->res);
+                batch[count++] = { io_uring_cqe_get_data(cqe), cqe->res, cqe->flags };
+                if (count == batch.size() || count == left) break;
+            }
+            io_uring_cq_advance(&ring, count);
+            left -= count;
+
+            for (unsigned i = 0; i < count; ++i) {
+                auto [user_data, res, flags] = batch[i];
+                auto bits = reinterpret_cast<uintptr_t>(user_data);
+                if (completion_kind(bits & completion_tag_mask) == completion_kind::resume) {
+                    auto* resolver = reinterpret_cast<resume_resolver *>(bits & ~completion_tag_mask);
+                    resolver->result = res;
+                    resolver->flags = flags;
+                    push_ready(*resolver);
+                } else {
+                    // Other resolvers queue the coroutines they wake up through schedule_ready
+                    dispatch_completion(user_data, res, flags);
+                }
             }
+        }
 
-            printf_if_verbose(__FILE__ ": Found %u cqe(s), looping...\n", cqe_count);
+        if (!timers.empty()) timers.expire(timer_wheel::clock::now());
+        resume_ready();
+        dispatching() = outer;
+        return handled;
+    }
 
-            io_uring_cq_advance(&ring, cqe_count);
-            cqe_count = 0;
+    // io_service running `run_batch` on this thread, whose ready queue schedule_ready fills
+    static io_service*& dispatching() noexcept {
+        thread_local io_service* service = nullptr;
+        return service;
+    }
+
+    friend void schedule_ready(ready_node& node) noexcept;
+
+    void push_ready(ready_node& node) noexcept {
+        auto& queue = ready[size_t(node.priority)];
+        node.next = nullptr;
+        if (queue.tail) queue.tail->next = &node;
+        else queue.head = &node;
+        queue.tail = &node;
+        ++ready_count;
+    }
+
+    // Resume queued coroutines, higher priority classes first, within the resume budget.
+    // Classes are scanned again after each one, as it may wake up others
+    void resume_ready() noexcept {
+        unsigned budget = resume_budget ? resume_budget : UINT_MAX;
+        for (size_t i = 0; i < ready.size() && budget; ) {
+            auto& queue = ready[i];
+            if (!queue.head) {
+                ++i;
+                continue;
+            }
+            auto* node = queue.head;
+            queue.head = node->next;
+            if (!queue.head) queue.tail = nullptr;
+            --ready_count;
+            --budget;
+            node->resume();
+            i = 0;
+        }
+    }
+
+    /** Submit pending sqes and make cqes available
+     * io_uring_enter is skipped when nothing is to be submitted and cqes are already there,
+     * unless the kernel flags pending task work ( IORING_SQ_TASKRUN ), which is then
+     * flushed without waiting so that it's handled in the same batch
+     * @param wait block until at least one cqe is available
+     * @param deadline latest time to wake up at, when waiting
+     * @note with IORING_SETUP_DEFER_TASKRUN, completions are only posted by io_uring_enter
+     *       ( GETEVENTS ) of this thread, see io_uring_get_events
+     */
+    void reap_events(bool wait = true, timer_wheel::clock::time_point deadline = timer_wheel::clock::time_point::max()) {
+        if (__builtin_expect(!staged.empty(), false)) flush_staged();
+        // Every path below submits the SQ, its sqes can't be moved anymore
+        sq_last = nullptr;
+
+        // Armed timers and `deadline` bound the wait. It's passed to io_uring_enter itself
+        // ( IORING_ENTER_EXT_ARG ), no timeout request is issued on recent kernels
+        __kernel_timespec ts;
+        __kernel_timespec* timeout = nullptr;
+        deadline = std::min(deadline, timers.next_wakeup());
+        if (wait && deadline != timer_wheel::clock::time_point::max()) {
+            auto left = deadline - timer_wheel::clock::now();
+            if (left <= left.zero()) {
+                wait = false;
+            } else {
+                ts = dur2ts(left);
+                timeout = &ts;
+            }
         }
 
-        return t.get_result();
+        // Time blocked in the kernel is accounted for the adaptive spin, too
+        auto spin_start = timer_wheel::clock::time_point::min();
+        if (wait && spin_budget.count() && !io_uring_cq_ready(&ring)) {
+            auto limit = spin_limit();
+            if (limit.count()) {
+                // The kernel can't complete what it hasn't seen
+                if (io_uring_sq_ready(&ring)) io_uring_submit(&ring);
+                spin_start = timer_wheel::clock::now();
+                auto until = std::min(spin_start + limit, deadline);
+                if (spin_for_cqe(until)) {
+                    record_wait(timer_wheel::clock::now() - spin_start);
+                    wait = false;
+                }
+            } else {
+                spin_start = timer_wheel::clock::now();
+            }
+        }
+        on_scope_exit record_blocked([&] () {
+            if (wait && spin_start != timer_wheel::clock::time_point::min()) {
+                record_wait(timer_wheel::clock::now() - spin_start);
+            }
+        });
+
+        if (flags_ & IORING_SETUP_SQPOLL) {
+            // Publish new sqes. liburing enters the kernel only to wake the poller thread
+            // up ( IORING_SQ_NEED_WAKEUP ), then we block only if no cqe is there yet
+            io_uring_submit(&ring);
+            if (wait && !io_uring_cq_ready(&ring)) {
+                io_uring_cqe* cqe;
+                if (timeout) {
+                    io_uring_wait_cqe_timeout(&ring, &cqe, timeout);
+                } else {
+                    io_uring_wait_cqe(&ring, &cqe);
+                }
+            }
+            return;
+        }
+        if (wait && (io_uring_sq_ready(&ring) || !io_uring_cq_ready(&ring))) {
+            if (timeout) {
+                io_uring_cqe* cqe;
+                io_uring_submit_and_wait_timeout(&ring, &cqe, 1, timeout, nullptr);
+            } else {
+                io_uring_submit_and_wait(&ring, 1);
+            }
+            return;
+        }
+
+        bool flush = (flags_ & IORING_SETUP_TASKRUN_FLAG) && (IO_URING_READ_ONCE(*ring.sq.kflags) & IORING_SQ_TASKRUN);
+        if (io_uring_sq_ready(&ring)) {
+            if (flush) {
+                io_uring_submit_and_get_events(&ring);
+            } else {
+                io_uring_submit(&ring);
+            }
+        } else if (flush) {
+            io_uring_get_events(&ring);
+        }
+    }
+
+    /** Busy poll the CQ ring until `until`, running pending task work without blocking
+     * @return true if a cqe is available
+     */
+    bool spin_for_cqe(timer_wheel::clock::time_point until) noexcept {
+        bool taskrun = flags_ & IORING_SETUP_TASKRUN_FLAG;
+        for (unsigned i = 1;; ++i) {
+            if (io_uring_cq_ready(&ring)) return true;
+            // Completions of COOP_TASKRUN / DEFER_TASKRUN rings wait for the task work to be run
+            if (taskrun && (IO_URING_READ_ONCE(*ring.sq.kflags) & IORING_SQ_TASKRUN)) {
+                io_uring_get_events(&ring);
+                continue;
+            }
+            // Reading the clock costs more than a pause
+            if (i % 16 == 0 && timer_wheel::clock::now() >= until) return false;
+            cpu_relax();
+        }
+    }
+
+    // How long the next wait spins
+    std::chrono::nanoseconds spin_limit() const noexcept {
+        if (!adaptive_spin) return spin_budget;
+        if (spin_average > spin_budget) return std::chrono::nanoseconds::zero();
+        return std::min(spin_budget, 2 * spin_average);
+    }
+
+    // Moving average of the time waits took, capped so that it recovers quickly from idle periods
+    void record_wait(std::chrono::nanoseconds elapsed) noexcept {
+        elapsed = std::min(elapsed, 2 * spin_budget);
+        spin_average += (elapsed - spin_average) / 8;
+    }
+
+    static void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    /** Move staged sqes into the SQ, submitting full batches on the way
+     * A batch ends with a link chain, so that chains reach the kernel in one io_uring_enter,
+     * unless a chain is longer than the SQ, or had more than its head in the SQ before it was
+     * full; see io_uring_get_sqe_safe. The last batch is left to the caller to submit
+     */
+    void flush_staged() noexcept {
+        if (moved_slot) {
+            // An awaitable may have set the user_data of the sqe after it was moved
+            if (moved_slot->user_data != reinterpret_cast<uintptr_t>(internal_user_data)) {
+                staged.front().user_data = std::exchange(moved_slot->user_data, reinterpret_cast<uintptr_t>(internal_user_data));
+            }
+            moved_slot = nullptr;
+        }
+        while (!staged.empty()) {
+            size_t space = io_uring_sq_space_left(&ring);
+            size_t batch = 0;
+            if (staged.size() <= space) {
+                batch = staged.size();
+            } else {
+                for (size_t i = 0; i < space; ++i) {
+                    if (!(staged[i].flags & (IOSQE_IO_LINK | IOSQE_IO_HARDLINK))) batch = i + 1;
+                }
+                if (!batch && io_uring_sq_ready(&ring)) {
+                    // Make room for the chain, the poller thread frees entries asynchronously
+                    io_uring_submit(&ring);
+                    if (flags_ & IORING_SETUP_SQPOLL) io_uring_sqring_wait(&ring);
+                    continue;
+                }
+                if (!batch) batch = space;
+            }
+            printf_if_verbose(__FILE__ ": Moving %zu staged sqe(s) into the SQ\n", batch);
+            for (size_t i = 0; i < batch; ++i) {
+                *(sq_last = io_uring_get_sqe(&ring)) = staged[i];
+            }
+            staged.erase(staged.begin(), staged.begin() + batch);
+            if (!staged.empty()) io_uring_submit(&ring);
+        }
+    }
+
+    /** Move the last sqe of the SQ into `staged`, ahead of the sqes linked after it
+     * Its slot is turned into a nop. The user_data set there afterwards, through a pointer
+     * to the slot, is forwarded by flush_staged
+     * @return the staged sqe
+     */
+    io_uring_sqe* stage_sq_last() noexcept {
+        auto* sqe = &staged.emplace_back(*sq_last);
+        moved_slot = std::exchange(sq_last, nullptr);
+        io_uring_prep_nop(moved_slot);
+        io_uring_sqe_set_data(moved_slot, internal_user_data);
+        return sqe;
+    }
+
+    /** Drop the newest optional setup mode, used when the kernel rejects them */
+    static uint32_t drop_newest_mode(uint32_t optional) noexcept {
+        if (optional & IORING_SETUP_DEFER_TASKRUN) {
+            optional &= ~IORING_SETUP_DEFER_TASKRUN;
+        } else if (optional & IORING_SETUP_SINGLE_ISSUER) {
+            optional &= ~IORING_SETUP_SINGLE_ISSUER;
+        } else {
+            optional &= ~(IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG);
+        }
+        // TASKRUN_FLAG is only valid with COOP_TASKRUN or DEFER_TASKRUN
+        if (!(optional & (IORING_SETUP_COOP_TASKRUN | IORING_SETUP_DEFER_TASKRUN))) {
+            optional &= ~IORING_SETUP_TASKRUN_FLAG;
+        }
+        return optional;
     }
 
 public:
@@ -725,6 +1656,61 @@ public:
     }
 
 public:
+    /** Register an eventfd signalled on new cqes, e.g. to drive `poll` from an epoll or GUI loop
+     * @see io_uring_register(2) IORING_REGISTER_EVENTFD IORING_REGISTER_EVENTFD_ASYNC
+     * @param async only signal for requests completed asynchronously, not inline on submission
+     */
+    void register_eventfd(int fd, bool async = false) {
+        if (async) {
+            io_uring_register_eventfd_async(&ring, fd) | panic_on_err("io_uring_register_eventfd_async", false);
+        } else {
+            io_uring_register_eventfd(&ring, fd) | panic_on_err("io_uring_register_eventfd", false);
+        }
+    }
+
+    /** Unregister the eventfd
+     * @see io_uring_register(2) IORING_UNREGISTER_EVENTFD
+     */
+    int unregister_eventfd() noexcept {
+        return io_uring_unregister_eventfd(&ring);
+    }
+
+public:
+    /** Is the opcode supported by current kernel
+     * @param opcode IORING_OP_*, only those probed by the constructor are known
+     */
+    [[nodiscard]]
+    bool is_supported(io_uring_op opcode) const noexcept {
+        return opcode < IORING_OP_LAST && probe_ops[opcode];
+    }
+
+    /** IORING_SETUP_* flags in effect, i.e. the modes accepted by current kernel */
+    [[nodiscard]]
+    uint32_t setup_flags() const noexcept {
+        return flags_;
+    }
+
+    /** IORING_FEAT_* flags reported by current kernel */
+    [[nodiscard]]
+    uint32_t features() const noexcept {
+        return features_;
+    }
+
+    /** Let `scheduler` run its ready work between batches of cqes, nullptr for none
+     * @see run_scheduler
+     */
+    void set_scheduler(run_scheduler* scheduler) noexcept {
+        this->scheduler = scheduler;
+    }
+
+    /** Timer wheel driven by `run`, e.g. for `timer`s
+     * @see sleep_for
+     */
+    [[nodiscard]]
+    timer_wheel& get_timers() noexcept {
+        return timers;
+    }
+
     /** Return internal io_uring handle */
     [[nodiscard]]
     io_uring& get_handle() noexcept {
@@ -733,8 +1719,64 @@ public:
 
 private:
     io_uring ring;
-    unsigned cqe_count = 0;
+    uint32_t flags_ = 0;
+    uint32_t features_ = 0;
+    run_scheduler* scheduler = nullptr;
+    timer_wheel timers;
+    std::chrono::nanoseconds spin_budget;
+    std::chrono::nanoseconds spin_average;
+    bool adaptive_spin;
+    unsigned resume_budget;
+    // Coroutines woken up, to be resumed, per resume_priority
+    struct ready_queue {
+        ready_node* head = nullptr;
+        ready_node* tail = nullptr;
+    };
+    std::array<ready_queue, resume_priority_count> ready;
+    size_t ready_count = 0;
+    // sqes gotten while the SQ is full, in order. A deque keeps them in place when growing
+    std::deque<io_uring_sqe> staged;
+    // The last sqe taken from the SQ and not submitted yet, and the slot of one moved into `staged`
+    io_uring_sqe* sq_last = nullptr;
+    io_uring_sqe* moved_slot = nullptr;
     bool probe_ops[IORING_OP_LAST] = {};
 };
 
+inline void schedule_ready(ready_node& node) noexcept {
+    if (auto* service = io_service::dispatching()) service->push_ready(node);
+    else node.resume();
+}
+
+inline multishot_awaitable::~multishot_awaitable() {
+    if (!resolver) return;
+    for (auto [result, flags] : resolver->completions) {
+        resolver->discard(result, flags);
+    }
+    if (!resolver->armed) {
+        delete resolver;
+        return;
+    }
+    resolver->completions.clear();
+    resolver->waiter = nullptr;
+    resolver->detached = true;
+    cancel();
+}
+
+inline void multishot_awaitable::cancel() noexcept {
+    if (!resolver) return;
+    if (resolver->starved) {
+        // Nothing is in flight
+        resolver->starved = false;
+        return;
+    }
+    if (!resolver->armed) return;
+    auto* sqe = service->io_uring_get_sqe_safe();
+    io_uring_prep_cancel(sqe, static_cast<uio::resolver *>(resolver), 0);
+    io_uring_sqe_set_data(sqe, internal_user_data);
+}
+
+inline void recv_multishot_resolver::rearm() noexcept {
+    prepare(service->io_uring_get_sqe_safe());
+}
+
 } // namespace uio
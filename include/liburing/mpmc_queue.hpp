@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace uio {
+/**
+ * A bounded multi-producer multi-consumer queue
+ * Each cell carries a sequence number telling whether it's ready to be written or read,
+ * so producers and consumers only contend on their own index. All operations are lock free,
+ * and no memory is allocated after construction.
+ * @see https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ */
+template <typename T>
+class mpmc_queue {
+public:
+    /** @param capacity maximum number of items, must be a power of 2 */
+    explicit mpmc_queue(size_t capacity)
+        : mask(capacity - 1)
+        , cells(new cell[capacity]) {
+        assert(capacity && (capacity & (capacity - 1)) == 0 && "capacity must be a power of 2");
+        for (size_t i = 0; i < capacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~mpmc_queue() {
+        while (try_pop()) {}
+    }
+
+    mpmc_queue(const mpmc_queue&) = delete;
+    mpmc_queue& operator =(const mpmc_queue&) = delete;
+
+    /** Push an item
+     * @param value moved from only if pushed
+     * @return false if the queue is full
+     */
+    bool try_push(T& value) noexcept(std::is_nothrow_move_constructible_v<T>) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        cell* c;
+        for (;;) {
+            c = &cells[pos & mask];
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            auto diff = intptr_t(seq) - intptr_t(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        new (c->storage) T(std::move(value));
+        c->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Pop the oldest item, nullopt if the queue is empty */
+    std::optional<T> try_pop() noexcept(std::is_nothrow_move_constructible_v<T>) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        cell* c;
+        for (;;) {
+            c = &cells[pos & mask];
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            auto diff = intptr_t(seq) - intptr_t(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return std::nullopt;
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        auto* item = std::launder(reinterpret_cast<T *>(c->storage));
+        std::optional<T> result(std::move(*item));
+        item->~T();
+        c->sequence.store(pos + mask + 1, std::memory_order_release);
+        return result;
+    }
+
+    /** Number of items, only a hint when the queue is used concurrently */
+    size_t size() const noexcept {
+        size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+        size_t head = dequeue_pos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    size_t capacity() const noexcept {
+        return mask + 1;
+    }
+
+private:
+    struct cell {
+        std::atomic<size_t> sequence;
+        alignas(T) std::byte storage[sizeof(T)];
+    };
+
+    // Producers and consumers write different indexes, keep them on different cache lines
+    alignas(64) std::atomic<size_t> enqueue_pos = 0;
+    alignas(64) std::atomic<size_t> dequeue_pos = 0;
+    size_t mask;
+    std::unique_ptr<cell[]> cells;
+};
+
+} // namespace uio
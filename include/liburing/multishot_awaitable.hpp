@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cerrno>
+#include <deque>
+#include <utility>
+#include <unistd.h>
+#include <liburing.h>
+
+#include <liburing/stdlib_coroutine.hpp>
+#include <liburing/sqe_awaitable.hpp>
+#include <liburing/buffer_ring.hpp>
+
+namespace uio {
+class io_service;
+
+/** Resolver of a multishot request, which can be completed many times
+ * Completions that arrive while the consumer is busy are queued in order.
+ * It's heap allocated and owned by a multishot_awaitable; once detached, it
+ * deletes itself when the kernel posts the final cqe (without IORING_CQE_F_MORE)
+ */
+struct multishot_resolver: resolver {
+    friend struct multishot_awaitable;
+    friend struct multishot_buffer_awaitable;
+
+    virtual ~multishot_resolver() = default;
+
+    void resolve(int result, uint32_t flags) noexcept override {
+        if (!(flags & IORING_CQE_F_MORE)) armed = false;
+        if (detached) {
+            discard(result, flags);
+            if (!armed) delete this;
+            return;
+        }
+        if (!armed && rearmable(result)) {
+            // Not a real completion. Issue the request again once the consumer asks for more
+            starved = true;
+            if (waiter) ready();
+            return;
+        }
+        completions.emplace_back(result, flags);
+        // NOTE: the consumer may destroy its stream when resumed in place. Don't touch `this` afterwards
+        if (waiter) schedule_ready(*std::exchange(waiter, nullptr));
+    }
+
+protected:
+    /** Release whatever a completion carries when nobody will consume it */
+    virtual void discard(int result, uint32_t flags) noexcept {}
+
+    /** Should the request be issued again after the kernel terminated it with `result` */
+    virtual bool rearmable(int result) const noexcept { return false; }
+
+    /** Issue the request again */
+    virtual void rearm() noexcept {}
+
+private:
+    bool ready() noexcept {
+        if (starved) {
+            starved = false;
+            armed = true;
+            rearm();
+        }
+        return !completions.empty() || !armed;
+    }
+
+    std::pair<int, uint32_t> next() noexcept {
+        if (completions.empty()) return { -ECANCELED, 0 };
+        auto completion = completions.front();
+        completions.pop_front();
+        return completion;
+    }
+
+    // Node of the consumer waiting for a completion, in its awaiter
+    ready_node* waiter = nullptr;
+    std::deque<std::pair<int, uint32_t>> completions;
+    bool armed = true;
+    bool starved = false;
+    bool detached = false;
+};
+
+/** Multishot accept resolver, closes connections accepted after detaching */
+struct accept_resolver final: multishot_resolver {
+protected:
+    void discard(int result, uint32_t) noexcept override {
+        if (result >= 0) ::close(result);
+    }
+};
+
+/** Multishot recv resolver, re-arms when the buffer ring runs dry (ENOBUFS) */
+struct recv_multishot_resolver final: multishot_resolver {
+    recv_multishot_resolver(io_service& service, buffer_ring& ring, int sockfd, uint32_t flags, uint8_t iflags) noexcept
+        : service(&service), ring(&ring), sockfd(sockfd), flags(flags), iflags(iflags) {}
+
+    void prepare(io_uring_sqe* sqe) noexcept {
+        io_uring_prep_recv_multishot(sqe, sockfd, nullptr, 0, flags);
+        io_uring_sqe_set_flags(sqe, iflags | IOSQE_BUFFER_SELECT);
+        sqe->buf_group = uint16_t(ring->group_id());
+        io_uring_sqe_set_data(sqe, static_cast<uio::resolver *>(this));
+    }
+
+protected:
+    void discard(int result, uint32_t flags) noexcept override {
+        buffer_lease(*ring, result, flags).release();
+    }
+
+    bool rearmable(int result) const noexcept override {
+        return result == -ENOBUFS;
+    }
+
+    void rearm() noexcept override;
+
+private:
+    io_service* service;
+    buffer_ring* ring;
+    int sockfd;
+    uint32_t flags;
+    uint8_t iflags;
+};
+
+/**
+ * An awaitable stream of completions produced by one multishot sqe
+ * Each co_await returns the result of the next completion. Once the kernel
+ * terminates the request and every queued result is consumed, co_await
+ * returns -ECANCELED without suspending.
+ * @note Destroying the stream cancels the request if it's still armed
+ */
+struct multishot_awaitable {
+    multishot_awaitable(io_service& service, io_uring_sqe* sqe, multishot_resolver* resolver) noexcept
+        : service(&service), resolver(resolver) {
+        io_uring_sqe_set_data(sqe, static_cast<uio::resolver *>(resolver));
+    }
+
+    multishot_awaitable(multishot_awaitable&& other) noexcept
+        : service(other.service), resolver(std::exchange(other.resolver, nullptr)), priority(other.priority) {}
+    multishot_awaitable(const multishot_awaitable&) = delete;
+    multishot_awaitable& operator =(const multishot_awaitable&) = delete;
+
+    ~multishot_awaitable();
+
+    /** Is the kernel still producing completions for this stream */
+    bool armed() const noexcept {
+        return resolver && (resolver->armed || resolver->starved);
+    }
+
+    /** Ask the kernel to stop producing completions
+     * @see io_uring_enter(2) IORING_OP_ASYNC_CANCEL
+     * @note results already queued can still be consumed
+     */
+    void cancel() noexcept;
+
+    /** Resume the consuming coroutine with `priority` for every completion
+     * @return this stream
+     */
+    multishot_awaitable& with_priority(resume_priority priority) & noexcept {
+        this->priority = priority;
+        return *this;
+    }
+    multishot_awaitable&& with_priority(resume_priority priority) && noexcept {
+        this->priority = priority;
+        return std::move(*this);
+    }
+
+    auto operator co_await() noexcept {
+        struct await_multishot {
+            multishot_resolver* resolver;
+            ready_node node;
+
+            bool await_ready() const noexcept {
+                return resolver->ready();
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                node.handle = handle;
+                resolver->waiter = &node;
+            }
+
+            int await_resume() const noexcept {
+                return resolver->next().first;
+            }
+        };
+
+        return await_multishot { resolver, { .priority = priority } };
+    }
+
+protected:
+    io_service* service;
+    multishot_resolver* resolver;
+    resume_priority priority = resume_priority::normal;
+};
+
+/**
+ * An awaitable stream of buffers filled by one multishot sqe
+ * Each co_await returns a buffer_lease of the next completion, see multishot_awaitable
+ */
+struct multishot_buffer_awaitable: multishot_awaitable {
+    multishot_buffer_awaitable(io_service& service, io_uring_sqe* sqe, multishot_resolver* resolver, buffer_ring& ring) noexcept
+        : multishot_awaitable(service, sqe, resolver), ring(&ring) {}
+
+    /** @see multishot_awaitable::with_priority */
+    multishot_buffer_awaitable& with_priority(resume_priority priority) & noexcept {
+        this->priority = priority;
+        return *this;
+    }
+    multishot_buffer_awaitable&& with_priority(resume_priority priority) && noexcept {
+        this->priority = priority;
+        return std::move(*this);
+    }
+
+    auto operator co_await() noexcept {
+        struct await_multishot_buffer {
+            multishot_resolver* resolver;
+            buffer_ring* ring;
+            ready_node node;
+
+            bool await_ready() const noexcept {
+                return resolver->ready();
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                node.handle = handle;
+                resolver->waiter = &node;
+            }
+
+            buffer_lease await_resume() const noexcept {
+                auto [result, flags] = resolver->next();
+                return buffer_lease(*ring, result, flags);
+            }
+        };
+
+        return await_multishot_buffer { resolver, ring, { .priority = priority } };
+    }
+
+private:
+    buffer_ring* ring;
+};
+
+} // namespace uio
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+
+#include <liburing/io_service.hpp>
+#include <liburing/cancel_token.hpp>
+#include <liburing/work_deque.hpp>
+
+namespace uio {
+/** Options of runtime */
+struct runtime_options {
+    /** Number of worker threads, 0 for one per CPU */
+    unsigned threads = 0;
+    /** Pin each worker thread to a CPU */
+    bool pin_threads = false;
+    /** CPUs worker i is pinned to is cpus[i % cpus.size()]; empty for CPU i */
+    std::vector<int> cpus;
+    /** Options of the io_service of each worker. wq_fd is set by the runtime */
+    io_service_options service {};
+    /** Let idle workers steal coroutines yielded by `runtime::reschedule` from busy ones */
+    bool work_stealing = false;
+    /** Capacity of the ready queue of each worker, a power of 2 */
+    size_t ready_capacity = 1024;
+};
+
+/**
+ * A pool of worker threads, each running its own io_service
+ * Rings of all workers share the async worker pool (io-wq) of the first one
+ * ( IORING_SETUP_ATTACH_WQ ). Coroutines are started on a worker with `spawn_on`
+ * and stay on it.
+ * @note io_service of a worker is created by the worker thread itself, so that
+ *       IORING_SETUP_SINGLE_ISSUER and IORING_SETUP_DEFER_TASKRUN can be used
+ */
+class runtime {
+public:
+    /** Start worker threads, returning once every io_service is created
+     * @throw std::system_error if a worker can't be set up
+     */
+    explicit runtime(const runtime_options& options = {}) {
+        unsigned count = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        workers.reserve(count);
+        try {
+            uint32_t wq_fd = 0;
+            for (unsigned i = 0; i < count; ++i) {
+                int cpu = -1;
+                if (options.pin_threads) {
+                    cpu = options.cpus.empty() ? int(i) : options.cpus[i % options.cpus.size()];
+                }
+
+                auto& w = *workers.emplace_back(std::make_unique<worker>(*this, i, options));
+                std::promise<int> ready;
+                auto started = ready.get_future();
+                w.thread = std::thread(&runtime::worker_main, std::ref(*this), std::ref(w), options.service, wq_fd, cpu, std::move(ready));
+                int ring_fd = started.get();
+                if (i == 0) wq_fd = uint32_t(ring_fd);
+            }
+        } catch (...) {
+            stop();
+            join();
+            throw;
+        }
+    }
+
+    /** Stop and join all workers */
+    ~runtime() {
+        stop();
+        join();
+    }
+
+    runtime(const runtime&) = delete;
+    runtime& operator =(const runtime&) = delete;
+
+    /** Number of workers */
+    size_t size() const noexcept {
+        return workers.size();
+    }
+
+    /** io_service of worker `index`, e.g. the target of io_service::schedule_on
+     * @note it's only safe to issue requests to it from the worker thread
+     */
+    io_service& service(size_t index) const noexcept {
+        return *workers[index]->service;
+    }
+
+    /** Start a coroutine on worker `index`
+     * @param fn callable invoked on the worker thread as `fn(io_service&)`, returning a task.
+     *        The task is detached, exceptions escaping from it are discarded
+     * @return false if the runtime is stopping, in which case `fn` is dropped
+     */
+    template <typename Fn>
+    bool spawn_on(size_t index, Fn&& fn) {
+        auto& w = *workers.at(index);
+        bool wake;
+        {
+            std::lock_guard lock(w.mutex);
+            if (w.stopping.load(std::memory_order_relaxed)) return false;
+            wake = w.inbox.empty();
+            // Counted from now on, so that no worker exits while it's still queued
+            ++active;
+            w.inbox.emplace_back([this, fn = std::forward<Fn>(fn)] (worker& w) mutable {
+                spawned(*this, std::move(fn), *w.service);
+            });
+        }
+        // The worker drains the whole inbox once woken up
+        if (wake) ::eventfd_write(w.efd, 1);
+        return true;
+    }
+
+    /** Ask every worker to stop gracefully
+     * A worker stops taking new coroutines, cancels requests attached to its `stop_token`,
+     * then exits once every coroutine spawned on the runtime is finished, as coroutines
+     * may move between workers
+     */
+    void stop() noexcept {
+        for (auto& w : workers) {
+            {
+                std::lock_guard lock(w->mutex);
+                if (w->stopping.exchange(true)) continue;
+            }
+            ::eventfd_write(w->efd, 1);
+        }
+    }
+
+    /** Wait for every worker to exit */
+    void join() {
+        for (auto& w : workers) {
+            if (w->thread.joinable()) w->thread.join();
+        }
+    }
+
+    /** Stop token of current worker, nullptr if not called by a worker thread
+     * Requests attached to it with `with_cancel` are cancelled by `stop`
+     */
+    static cancel_token* stop_token() noexcept {
+        auto* w = local_worker();
+        return w ? w->token : nullptr;
+    }
+
+    /** io_service of current worker, nullptr if not called by a worker thread */
+    static io_service* current_service() noexcept {
+        auto* w = local_worker();
+        return w ? w->service : nullptr;
+    }
+
+    /** Let other ready coroutines run, and let an idle worker take this one over
+     * The coroutine is pushed to the ready queue of current worker. The worker runs it
+     * again before blocking for cqes, unless an idle worker steals it first.
+     * Cqes still resume their coroutines on the ring owning the request, so this is
+     * meant for CPU bound coroutines only.
+     * @note the coroutine may be resumed by another worker, issue requests to
+     *       `current_service()` afterwards
+     * @return an awaitable, which doesn't suspend if work stealing isn't enabled,
+     *         not called by a worker thread, or the ready queue is full
+     */
+    static auto reschedule() noexcept {
+        struct await_reschedule {
+            worker* w;
+
+            bool await_ready() const noexcept { return !w || !w->ready; }
+
+            bool await_suspend(std::coroutine_handle<> handle) noexcept {
+                // NOTE: the coroutine may be resumed by a thief before this returns
+                return w->rt->enqueue(*w, handle);
+            }
+
+            constexpr void await_resume() const noexcept {}
+        };
+
+        return await_reschedule { local_worker() };
+    }
+
+private:
+    struct worker final: run_scheduler {
+        worker(runtime& rt, size_t index, const runtime_options& options)
+            : rt(&rt)
+            , index(index)
+            , efd(::eventfd(0, EFD_CLOEXEC)) {
+            if (efd < 0) panic("eventfd", errno);
+            if (options.work_stealing) ready = std::make_unique<work_deque<void *>>(options.ready_capacity);
+        }
+
+        ~worker() {
+            ::close(efd);
+        }
+
+        bool run_ready() noexcept override {
+            // Resume coroutines yielded before, oldest first. The budget keeps cqes
+            // reaped while coroutines keep rescheduling themselves
+            bool ran = false;
+            for (size_t budget = ready->size(); budget; --budget) {
+                auto h = ready->steal();
+                if (!h) break;
+                std::coroutine_handle<>::from_address(*h).resume();
+                ran = true;
+            }
+            return ran || rt->steal_for(*this);
+        }
+
+        bool before_wait() noexcept override {
+            sleeping.store(true, std::memory_order_seq_cst);
+            // Either a coroutine enqueued concurrently is seen here, or its producer sees us sleeping
+            for (auto& w : rt->workers) {
+                if (!w->ready->empty()) {
+                    sleeping.store(false, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void after_wait() noexcept override {
+            sleeping.store(false, std::memory_order_relaxed);
+        }
+
+        runtime* rt;
+        size_t index;
+        std::thread thread;
+        io_service* service = nullptr;
+        cancel_token* token = nullptr;
+        int efd;
+        std::mutex mutex;
+        std::vector<std::function<void (worker&)>> inbox;
+        std::atomic<bool> stopping = false;
+        // Ready queue, only with work stealing enabled
+        std::unique_ptr<work_deque<void *>> ready;
+        std::atomic<bool> sleeping = false;
+    };
+
+    static worker*& local_worker() noexcept {
+        thread_local worker* w = nullptr;
+        return w;
+    }
+
+    // Push a coroutine to the ready queue of `w`, and wake an idle worker up to steal it
+    bool enqueue(worker& w, std::coroutine_handle<> handle) noexcept {
+        if (!w.ready->push(handle.address())) return false;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (auto& other : workers) {
+            if (other->sleeping.load(std::memory_order_relaxed) && other->sleeping.exchange(false)) {
+                ::eventfd_write(other->efd, 1);
+                break;
+            }
+        }
+        return true;
+    }
+
+    // Steal one coroutine from another worker, and run it on `thief`
+    bool steal_for(worker& thief) noexcept {
+        // Start from the next worker, so that thieves don't all hit the same victim first
+        size_t n = workers.size();
+        for (size_t i = 1; i < n; ++i) {
+            auto& victim = *workers[(thief.index + i) % n];
+            if (auto h = victim.ready->steal()) {
+                std::coroutine_handle<>::from_address(*h).resume();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // `fn` is moved into the coroutine frame: a coroutine lambda refers to its closure,
+    // which has to outlive the task it returns
+    template <typename Fn>
+    static task<> spawned(runtime& rt, Fn fn, io_service& service) {
+        try {
+            co_await fn(service);
+        } catch (...) {
+        }
+        rt.finish();
+    }
+
+    // Called when a spawned coroutine is finished. Maybe on another worker than the
+    // one it's spawned on, see io_service::schedule_on
+    void finish() noexcept {
+        if (--active == 0) {
+            for (auto& w : workers) {
+                if (w->stopping.load(std::memory_order_relaxed)) ::eventfd_write(w->efd, 1);
+            }
+        }
+    }
+
+    static void drain(runtime& rt, worker& w) {
+        std::vector<std::function<void (worker&)>> jobs;
+        {
+            std::lock_guard lock(w.mutex);
+            jobs.swap(w.inbox);
+        }
+        for (auto& job : jobs) {
+            try {
+                job(w);
+            } catch (...) {
+                // The coroutine frame of `spawned` couldn't be allocated
+                rt.finish();
+            }
+        }
+    }
+
+    static task<> serve(runtime& rt, worker& w, cancel_token& token) {
+        eventfd_t value;
+        while (!w.stopping.load(std::memory_order_acquire)) {
+            drain(rt, w);
+            co_await w.service->read(w.efd, &value, sizeof(value), 0);
+        }
+        // Coroutines spawned before stop() are in the inbox now
+        drain(rt, w);
+        token.cancel();
+        while (rt.active.load()) {
+            co_await w.service->read(w.efd, &value, sizeof(value), 0);
+        }
+    }
+
+    static void worker_main(runtime& rt, worker& w, io_service_options options, uint32_t wq_fd, int cpu, std::promise<int> ready) {
+        try {
+            if (cpu >= 0) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                if (int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+                    panic("pthread_setaffinity_np", ret);
+                }
+            }
+            options.wq_fd = wq_fd;
+            io_service service(options);
+            cancel_token token(service);
+            w.service = &service;
+            w.token = &token;
+            if (w.ready) service.set_scheduler(&w);
+            local_worker() = &w;
+            ready.set_value(service.get_handle().ring_fd);
+
+            service.run(serve(rt, w, token));
+            local_worker() = nullptr;
+        } catch (...) {
+            // Either setting up failed, or a coroutine escaped the loop which is a bug
+            try {
+                ready.set_exception(std::current_exception());
+            } catch (const std::future_error&) {
+                std::terminate();
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<worker>> workers;
+    // Coroutines spawned and not finished yet
+    std::atomic<size_t> active = 0;
+};
+
+} // namespace uio
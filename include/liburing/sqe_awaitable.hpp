@@ -1,37 +1,123 @@
 #pragma once
 
 #include <climits>
+#include <cstdint>
 #include <liburing.h>
 #include <type_traits>
 #include <optional>
+#include <functional>
 #include <cassert>
 
 #include <liburing/stdlib_coroutine.hpp>
+#include <liburing/frame_allocator.hpp>
 
 namespace uio {
+class io_service;
+template <typename Awaitable>
+struct deadline_awaitable;
+struct when_access;
+
+/** Kind of target a cqe is dispatched to, stored in the low bits of user_data
+ * Targets are at least 8 bytes aligned, so 3 bits are free for the tag. The common
+ * kinds are handled by a switch in io_service::run rather than an indirect call
+ */
+enum class completion_kind: uintptr_t {
+    resolver = 0, // resolver::resolve, virtual. For requests completed more than once
+    resume = 1,   // resume_resolver: store the result and resume the awaiting coroutine, queued by io_service::run
+    deferred = 2, // deferred_resolver: store the result
+    callback = 3, // callback_resolver: invoke the callback, queued like coroutines, and recycle the resolver
+    internal = 4, // Requests issued by the library itself (cancels, link timeouts), ignored
+};
+
+constexpr uintptr_t completion_tag_mask = 7;
+
+/** Encode `target` and its kind into user_data */
+inline void* make_user_data(void* target, completion_kind kind) noexcept {
+    assert((reinterpret_cast<uintptr_t>(target) & completion_tag_mask) == 0);
+    return reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(target) | uintptr_t(kind));
+}
+
+/** user_data of requests whose completion is ignored */
+inline void* const internal_user_data = reinterpret_cast<void *>(uintptr_t(completion_kind::internal));
+
 struct resolver {
-    virtual void resolve(int result) noexcept = 0;
+    /** Called by io_service::run for every cqe carrying this resolver
+     * @param result cqe->res
+     * @param flags cqe->flags, IORING_CQE_F_*
+     */
+    virtual void resolve(int result, uint32_t flags) noexcept = 0;
+};
+
+/** Priority class of a coroutine resumed by io_service::run
+ * Classes are served strictly in order, within io_service_options::resume_budget
+ */
+enum class resume_priority: uint8_t {
+    control = 0, // Latency sensitive, e.g. accepting connections, heartbeats
+    normal = 1,
+    bulk = 2,    // Throughput work, e.g. file transfers
+};
+
+constexpr size_t resume_priority_count = 3;
+
+/** A coroutine to resume, or a callback to run, from the ready queue of io_service
+ * Linked intrusively, it lives in whatever wakes it up: a resolver, or the awaiter of the coroutine
+ */
+struct ready_node {
+    std::coroutine_handle<> handle;
+    // Link of the ready queue of io_service
+    ready_node* next = nullptr;
+    resume_priority priority = resume_priority::normal;
+    // Called instead of resuming `handle`, may destroy the node
+    void (*run)(ready_node&) noexcept = nullptr;
+
+    void resume() noexcept {
+        if (run) run(*this);
+        else handle.resume();
+    }
 };
 
-struct resume_resolver final: resolver {
+/** Queue `node` to the io_service dispatching completions on this thread, i.e. within
+ * io_service::run, so that it's served by priority within the resume budget. It's
+ * resumed in place if no io_service is dispatching
+ * @note defined in io_service.hpp
+ */
+inline void schedule_ready(ready_node& node) noexcept;
+
+struct resume_resolver final: ready_node {
+    friend class io_service;
     friend struct sqe_awaitable;
+    friend struct buffer_awaitable;
+    friend struct schedule_awaitable;
+    friend class blocking_pool;
+    friend class cross_ring_mutex;
+    template <typename T> friend class cross_ring_channel;
 
-    void resolve(int result) noexcept override {
+    void resolve(int result, uint32_t flags) noexcept {
         this->result = result;
-        handle.resume();
+        this->flags = flags;
+        schedule_ready(*this);
+    }
+
+    /** Tagged user_data referring to this resolver */
+    void* user_data() noexcept {
+        return make_user_data(this, completion_kind::resume);
     }
 
 private:
-    std::coroutine_handle<> handle;
     int result = 0;
+    uint32_t flags = 0;
 };
 static_assert(std::is_trivially_destructible_v<resume_resolver>);
 
-struct deferred_resolver final: resolver {
-    void resolve(int result) noexcept override {
+struct alignas(8) deferred_resolver final {
+    void resolve(int result, uint32_t) noexcept {
         this->result = result;
     }
 
+    void* user_data() noexcept {
+        return make_user_data(this, completion_kind::deferred);
+    }
+
 #ifndef NDEBUG
     ~deferred_resolver() {
         assert(!!result && "deferred_resolver is destructed before it's resolved");
@@ -41,29 +127,82 @@ struct deferred_resolver final: resolver {
     std::optional<int> result;
 };
 
-struct callback_resolver final: resolver {
-    callback_resolver(std::function<void (int result)>&& cb): cb(std::move(cb)) {}
+/** Heap allocated resolver of set_callback, recycled through the frame_pool of current thread */
+struct callback_resolver final: ready_node {
+    callback_resolver(std::function<void (int result)>&& cb, resume_priority priority = resume_priority::normal)
+        : cb(std::move(cb)) {
+        this->priority = priority;
+        run = [] (ready_node& node) noexcept {
+            auto* self = static_cast<callback_resolver *>(&node);
+            self->cb(self->result);
+            delete self;
+        };
+    }
+
+    static void* operator new(size_t size) {
+        return frame_pool::local().allocate(size);
+    }
+
+    static void operator delete(void* ptr, size_t size) noexcept {
+        frame_pool::local().deallocate(ptr, size);
+    }
+
+    void resolve(int result, uint32_t) noexcept {
+        this->result = result;
+        schedule_ready(*this);
+    }
 
-    void resolve(int result) noexcept override {
-        this->cb(result);
-        delete this;
+    void* user_data() noexcept {
+        return make_user_data(this, completion_kind::callback);
     }
 
 private:
     std::function<void (int result)> cb;
+    int result = 0;
 };
 
+/** Dispatch a cqe to the target encoded in its user_data
+ * @see completion_kind
+ */
+inline void dispatch_completion(void* user_data, int result, uint32_t flags) noexcept {
+    auto bits = reinterpret_cast<uintptr_t>(user_data);
+    auto* target = reinterpret_cast<void *>(bits & ~completion_tag_mask);
+    switch (completion_kind(bits & completion_tag_mask)) {
+    case completion_kind::resume:
+        return static_cast<resume_resolver *>(target)->resolve(result, flags);
+    case completion_kind::deferred:
+        return static_cast<deferred_resolver *>(target)->resolve(result, flags);
+    case completion_kind::callback:
+        return static_cast<callback_resolver *>(target)->resolve(result, flags);
+    case completion_kind::resolver:
+        // nullptr is used by requests nobody awaits
+        if (target) static_cast<resolver *>(target)->resolve(result, flags);
+        return;
+    default:
+        return;
+    }
+}
+
 struct sqe_awaitable {
-    // TODO: use cancel_token to implement cancellation
-    sqe_awaitable(io_uring_sqe* sqe) noexcept: sqe(sqe) {}
+    // See cancel_token.hpp for cancellation and deadlines
+    sqe_awaitable(io_uring_sqe* sqe, io_service* service = nullptr) noexcept: sqe(sqe), service(service) {}
 
     // User MUST keep resolver alive before the operation is finished
     void set_deferred(deferred_resolver& resolver) {
-        io_uring_sqe_set_data(sqe, &resolver);
+        io_uring_sqe_set_data(sqe, resolver.user_data());
     }
 
     void set_callback(std::function<void (int result)> cb) {
-        io_uring_sqe_set_data(sqe, new callback_resolver(std::move(cb)));
+        io_uring_sqe_set_data(sqe, (new callback_resolver(std::move(cb), priority))->user_data());
+    }
+
+    /** Resume the awaiting coroutine ( or run the callback ) with `priority` once the request completes
+     * @return a copy of this awaitable
+     */
+    sqe_awaitable with_priority(resume_priority priority) const noexcept {
+        auto op = *this;
+        op.priority = priority;
+        return op;
     }
 
     auto operator co_await() {
@@ -71,19 +210,59 @@ struct sqe_awaitable {
             resume_resolver resolver {};
             io_uring_sqe* sqe;
 
-            await_sqe(io_uring_sqe* sqe): sqe(sqe) {}
+            await_sqe(io_uring_sqe* sqe, resume_priority priority): sqe(sqe) {
+                resolver.priority = priority;
+            }
+
+            constexpr bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                resolver.handle = handle;
+                io_uring_sqe_set_data(sqe, resolver.user_data());
+            }
+
+            constexpr int await_resume() const noexcept { return resolver.result; }
+        };
+
+        return await_sqe(sqe, priority);
+    }
+
+private:
+    template <typename> friend struct deadline_awaitable;
+    friend struct when_access;
+    io_uring_sqe* sqe;
+    io_service* service;
+    resume_priority priority = resume_priority::normal;
+};
+
+/**
+ * Awaitable of io_service::schedule_on
+ * The coroutine is resumed by the target ring on success ( the message cqe ), or by
+ * the issuing ring on failure ( IOSQE_CQE_SKIP_SUCCESS makes it post nothing otherwise )
+ */
+struct schedule_awaitable {
+    schedule_awaitable(io_uring_sqe* sqe) noexcept: sqe(sqe) {}
+
+    auto operator co_await() {
+        struct await_schedule {
+            resume_resolver resolver {};
+            io_uring_sqe* sqe;
+
+            await_schedule(io_uring_sqe* sqe): sqe(sqe) {}
 
             constexpr bool await_ready() const noexcept { return false; }
 
             void await_suspend(std::coroutine_handle<> handle) noexcept {
                 resolver.handle = handle;
-                io_uring_sqe_set_data(sqe, &resolver);
+                // user_data of the message cqe is carried in sqe->off
+                sqe->off = reinterpret_cast<uintptr_t>(resolver.user_data());
+                io_uring_sqe_set_data(sqe, resolver.user_data());
             }
 
             constexpr int await_resume() const noexcept { return resolver.result; }
         };
 
-        return await_sqe(sqe);
+        return await_schedule(sqe);
     }
 
 private:
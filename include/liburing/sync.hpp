@@ -0,0 +1,455 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+/** Intrusive FIFO of suspended coroutines, linked through ready_node::next
+ * Nodes live in the awaiters, i.e. the coroutine frames. A waiter woken up is queued
+ * by schedule_ready, so that waking many never resumes them recursively
+ */
+class waiter_queue {
+public:
+    bool empty() const noexcept {
+        return !head;
+    }
+
+    void push(ready_node* node) noexcept {
+        node->next = nullptr;
+        if (tail) tail->next = node;
+        else head = node;
+        tail = node;
+    }
+
+    ready_node* front() const noexcept {
+        return head;
+    }
+
+    ready_node* pop() noexcept {
+        auto* node = head;
+        if (node) {
+            head = node->next;
+            if (!head) tail = nullptr;
+        }
+        return node;
+    }
+
+    /** Take every waiter at once */
+    ready_node* take_all() noexcept {
+        tail = nullptr;
+        return std::exchange(head, nullptr);
+    }
+
+private:
+    ready_node* head = nullptr;
+    ready_node* tail = nullptr;
+};
+
+/** Resume a coroutine suspended on `target` through its resume_resolver
+ * Queued by schedule_ready if `target` is `current`, otherwise by posting a cqe to `target`
+ * ( IORING_OP_MSG_RING ), which is retried while CQ ring of `target` is full
+ * @param current io_service of the calling thread
+ * @note panics if the cqe can't be posted for another reason, e.g. `target` is gone
+ */
+inline void resume_on_ring(io_service& current, io_service& target, resume_resolver& resolver) noexcept {
+    if (&target == &current) {
+        resolver.resolve(0, 0);
+        return;
+    }
+    auto* sqe = current.io_uring_get_sqe_safe();
+    io_uring_prep_msg_ring(sqe, target.get_handle().ring_fd, 0, reinterpret_cast<uintptr_t>(resolver.user_data()), 0);
+    auto* retry = new callback_resolver([&current, &target, &resolver] (int result) {
+        if (result == -EOVERFLOW || result == -EAGAIN) {
+            resume_on_ring(current, target, resolver);
+        } else if (result < 0) {
+            // The coroutine could never be resumed, fail loudly instead of hanging it
+            panic("io_uring_prep_msg_ring", -result);
+        }
+    });
+    io_uring_sqe_set_data(sqe, retry->user_data());
+}
+
+class async_mutex;
+
+/** RAII ownership of an async_mutex, see async_mutex::scoped_lock */
+class async_lock_guard {
+public:
+    explicit async_lock_guard(async_mutex& mutex) noexcept: mutex(&mutex) {}
+    async_lock_guard(async_lock_guard&& other) noexcept: mutex(std::exchange(other.mutex, nullptr)) {}
+    async_lock_guard(const async_lock_guard&) = delete;
+    async_lock_guard& operator =(const async_lock_guard&) = delete;
+    ~async_lock_guard();
+
+    /** Unlock the mutex before the guard is destroyed */
+    void unlock() noexcept;
+
+private:
+    async_mutex* mutex;
+};
+
+/**
+ * A mutex for coroutines running on one io_service
+ * Locking and unlocking never enter the kernel. When unlocked, the ownership is
+ * handed over to the first waiter, which is queued by schedule_ready.
+ * @note like io_service, it's NOT thread safe. See cross_ring_mutex
+ */
+class async_mutex {
+public:
+    async_mutex() noexcept = default;
+    async_mutex(const async_mutex&) = delete;
+    async_mutex& operator =(const async_mutex&) = delete;
+
+#ifndef NDEBUG
+    ~async_mutex() {
+        assert(waiters.empty() && "async_mutex is destructed while coroutines are waiting");
+    }
+#endif
+
+    bool try_lock() noexcept {
+        if (locked) return false;
+        locked = true;
+        return true;
+    }
+
+    /** Lock the mutex
+     * @return an awaitable, resolved once the mutex is owned
+     */
+    auto lock() noexcept {
+        struct await_lock: ready_node {
+            async_mutex* mutex;
+
+            bool await_ready() noexcept { return mutex->try_lock(); }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                this->handle = handle;
+                mutex->waiters.push(this);
+            }
+
+            constexpr void await_resume() const noexcept {}
+        };
+
+        return await_lock { {}, this };
+    }
+
+    /** Lock the mutex
+     * @return an awaitable resolved with an async_lock_guard, which unlocks the mutex when destroyed
+     */
+    auto scoped_lock() noexcept {
+        struct await_scoped_lock {
+            decltype(std::declval<async_mutex&>().lock()) inner;
+
+            bool await_ready() noexcept { return inner.await_ready(); }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { inner.await_suspend(handle); }
+            async_lock_guard await_resume() const noexcept { return async_lock_guard(*inner.mutex); }
+        };
+
+        return await_scoped_lock { lock() };
+    }
+
+    /** Unlock the mutex, waking the first waiter up if any, which owns the mutex then */
+    void unlock() noexcept {
+        assert(locked && "unlocking an async_mutex not locked");
+        if (auto* w = waiters.pop()) {
+            schedule_ready(*w);
+        } else {
+            locked = false;
+        }
+    }
+
+private:
+    friend class async_condition_variable;
+
+    // Give the mutex to `w` if it's unlocked, otherwise queue `w` as if it called lock()
+    void lock_or_enqueue(ready_node* w) noexcept {
+        if (try_lock()) {
+            schedule_ready(*w);
+        } else {
+            waiters.push(w);
+        }
+    }
+
+    waiter_queue waiters;
+    bool locked = false;
+};
+
+inline async_lock_guard::~async_lock_guard() {
+    unlock();
+}
+
+inline void async_lock_guard::unlock() noexcept {
+    if (mutex) std::exchange(mutex, nullptr)->unlock();
+}
+
+/**
+ * A counting semaphore for coroutines running on one io_service
+ * @note like io_service, it's NOT thread safe
+ */
+class async_semaphore {
+public:
+    explicit async_semaphore(size_t count) noexcept: count(count) {}
+    async_semaphore(const async_semaphore&) = delete;
+    async_semaphore& operator =(const async_semaphore&) = delete;
+
+    bool try_acquire() noexcept {
+        if (!count) return false;
+        --count;
+        return true;
+    }
+
+    /** Acquire a unit
+     * @return an awaitable, resolved once a unit is acquired
+     */
+    auto acquire() noexcept {
+        struct await_acquire: ready_node {
+            async_semaphore* sem;
+
+            bool await_ready() noexcept { return sem->try_acquire(); }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                this->handle = handle;
+                sem->waiters.push(this);
+            }
+
+            constexpr void await_resume() const noexcept {}
+        };
+
+        return await_acquire { {}, this };
+    }
+
+    /** Release `n` units, waking as many waiters up as possible, which own the units then */
+    void release(size_t n = 1) noexcept {
+        count += n;
+        while (count) {
+            auto* w = waiters.pop();
+            if (!w) break;
+            --count;
+            schedule_ready(*w);
+        }
+    }
+
+    /** Units available */
+    size_t available() const noexcept {
+        return count;
+    }
+
+private:
+    waiter_queue waiters;
+    size_t count;
+};
+
+/**
+ * A manual-reset event for coroutines running on one io_service
+ * @note like io_service, it's NOT thread safe
+ */
+class async_event {
+public:
+    explicit async_event(bool set = false) noexcept: set_(set) {}
+    async_event(const async_event&) = delete;
+    async_event& operator =(const async_event&) = delete;
+
+    bool is_set() const noexcept {
+        return set_;
+    }
+
+    /** Set the event, waking every waiter up */
+    void set() noexcept {
+        set_ = true;
+        auto* w = waiters.take_all();
+        while (w) {
+            // NOTE: the node is linked into the ready queue then, read it before
+            schedule_ready(*std::exchange(w, w->next));
+        }
+    }
+
+    void reset() noexcept {
+        set_ = false;
+    }
+
+    /** Wait until the event is set
+     * @return an awaitable, which doesn't suspend if the event is already set
+     */
+    auto wait() noexcept {
+        struct await_event: ready_node {
+            async_event* event;
+
+            bool await_ready() const noexcept { return event->set_; }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                this->handle = handle;
+                event->waiters.push(this);
+            }
+
+            constexpr void await_resume() const noexcept {}
+        };
+
+        return await_event { {}, this };
+    }
+
+private:
+    waiter_queue waiters;
+    bool set_;
+};
+
+/**
+ * A condition variable for coroutines running on one io_service, used with async_mutex
+ * A notified waiter is moved to the waiters of its mutex rather than resumed to contend
+ * for it, so notifying never resumes a coroutine that would just wait again
+ * @note like io_service, it's NOT thread safe
+ */
+class async_condition_variable {
+public:
+    async_condition_variable() noexcept = default;
+    async_condition_variable(const async_condition_variable&) = delete;
+    async_condition_variable& operator =(const async_condition_variable&) = delete;
+
+    /** Unlock `mutex` and wait for a notification
+     * @param mutex an async_mutex locked by the caller
+     * @return an awaitable, resolved once notified and `mutex` is locked again
+     */
+    auto wait(async_mutex& mutex) noexcept {
+        struct await_notify: waiter {
+            async_condition_variable* cv;
+
+            constexpr bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                this->handle = handle;
+                cv->waiters.push(this);
+                mutex->unlock();
+            }
+
+            constexpr void await_resume() const noexcept {}
+        };
+
+        return await_notify { { {}, &mutex }, this };
+    }
+
+    /** Wake one waiter up, if any */
+    void notify_one() noexcept {
+        if (auto* w = waiters.pop()) {
+            auto* node = static_cast<waiter *>(w);
+            node->mutex->lock_or_enqueue(node);
+        }
+    }
+
+    /** Wake every waiter up */
+    void notify_all() noexcept {
+        auto* w = waiters.take_all();
+        while (w) {
+            auto* node = static_cast<waiter *>(std::exchange(w, w->next));
+            node->mutex->lock_or_enqueue(node);
+        }
+    }
+
+private:
+    struct waiter: ready_node {
+        async_mutex* mutex;
+    };
+
+    waiter_queue waiters;
+};
+
+/**
+ * A mutex for coroutines running on different io_services, i.e. threads
+ * The lock state and waiters are managed by a lock free atomic word, so neither
+ * uncontended locking nor unlocking enters the kernel. When contended, the ownership
+ * is handed over to the first waiter, which is resumed by its own ring: queued by
+ * schedule_ready if it's the ring of the unlocking coroutine, or by posting a cqe to it ( IORING_OP_MSG_RING )
+ * @see https://github.com/lewissbaker/cppcoro async_mutex for the algorithm
+ */
+class cross_ring_mutex {
+public:
+    cross_ring_mutex() noexcept = default;
+    cross_ring_mutex(const cross_ring_mutex&) = delete;
+    cross_ring_mutex& operator =(const cross_ring_mutex&) = delete;
+
+#ifndef NDEBUG
+    ~cross_ring_mutex() {
+        assert(state.load() == not_locked && "cross_ring_mutex is destructed while locked");
+    }
+#endif
+
+    bool try_lock() noexcept {
+        auto old = not_locked;
+        return state.compare_exchange_strong(old, locked_no_waiters, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    /** Lock the mutex
+     * @param service io_service running the awaiting coroutine, which is resumed by it
+     * @return an awaitable, resolved once the mutex is owned
+     */
+    auto lock(io_service& service) noexcept {
+        struct await_lock: waiter {
+            cross_ring_mutex* mutex;
+
+            bool await_ready() noexcept { return mutex->try_lock(); }
+
+            bool await_suspend(std::coroutine_handle<> handle) noexcept {
+                resolver.handle = handle;
+                auto old = mutex->state.load(std::memory_order_acquire);
+                for (;;) {
+                    if (old == not_locked) {
+                        if (mutex->state.compare_exchange_weak(old, locked_no_waiters, std::memory_order_acquire, std::memory_order_relaxed)) {
+                            return false;
+                        }
+                    } else {
+                        next = old == locked_no_waiters ? nullptr : reinterpret_cast<waiter *>(old);
+                        if (mutex->state.compare_exchange_weak(old, reinterpret_cast<uintptr_t>(static_cast<waiter *>(this)), std::memory_order_release, std::memory_order_relaxed)) {
+                            return true;
+                        }
+                    }
+                }
+            }
+
+            constexpr void await_resume() const noexcept {}
+        };
+
+        return await_lock { { {}, &service, nullptr }, this };
+    }
+
+    /** Unlock the mutex, handing it over to the first waiter if any
+     * @param service io_service running the unlocking coroutine, used to post the wakeup
+     */
+    void unlock(io_service& service) noexcept {
+        assert(state.load(std::memory_order_relaxed) != not_locked && "unlocking a cross_ring_mutex not locked");
+        auto* w = waiters;
+        if (!w) {
+            auto old = locked_no_waiters;
+            if (state.compare_exchange_strong(old, not_locked, std::memory_order_release, std::memory_order_relaxed)) {
+                return;
+            }
+            // Waiters are stacked, reverse them into the FIFO owned by the lock holder
+            old = state.exchange(locked_no_waiters, std::memory_order_acquire);
+            auto* stack = reinterpret_cast<waiter *>(old);
+            while (stack) {
+                auto* next = stack->next;
+                stack->next = w;
+                w = std::exchange(stack, next);
+            }
+        }
+        waiters = w->next;
+        resume_on_ring(service, *w->service, w->resolver);
+    }
+
+private:
+    struct waiter {
+        resume_resolver resolver;
+        io_service* service;
+        waiter* next;
+    };
+
+    static constexpr uintptr_t not_locked = 1;
+    static constexpr uintptr_t locked_no_waiters = 0;
+    // not_locked, locked_no_waiters, or a stack of waiters pushed by lock()
+    std::atomic<uintptr_t> state = not_locked;
+    // Waiters to be handed over to in order, only touched by the lock holder
+    waiter* waiters = nullptr;
+};
+
+} // namespace uio
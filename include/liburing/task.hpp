@@ -1,11 +1,13 @@
 #pragma once
 
 #include <exception>
+#include <utility>
 #include <variant>
 #include <array>
 #include <cassert>
 
 #include <liburing/stdlib_coroutine.hpp>
+#include <liburing/frame_allocator.hpp>
 
 namespace uio {
 template <typename T, bool nothrow>
@@ -14,6 +16,14 @@ struct task;
 // only for internal usage
 template <typename T, bool nothrow>
 struct task_promise_base {
+    // Coroutine frames are allocated by the frame allocator of current thread
+    static void* operator new(size_t size) {
+        return allocate_frame(size);
+    }
+    static void operator delete(void* ptr, size_t size) noexcept {
+        deallocate_frame(ptr, size);
+    }
+
     task<T, nothrow> get_return_object();
     auto initial_suspend() { return std::suspend_never(); }
     auto final_suspend() noexcept {
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include <liburing/stdlib_coroutine.hpp>
+#include <liburing/sqe_awaitable.hpp>
+
+namespace uio {
+/**
+ * A hierarchical timer wheel
+ * Timers are intrusive nodes hashed into 6 levels of 64 slots, level `l` covering
+ * 64^l ticks per slot. Arming and cancelling are O(1) without allocating. A timer is
+ * moved down one level at a time as its deadline gets near, and fired from level 0;
+ * occupancy bitmaps let idle periods be skipped at once.
+ * @see "Hashed and Hierarchical Timing Wheels", Varghese & Lauck, SOSP 1987
+ * @note timers never fire early, and late by at most one tick plus the time spent
+ *       out of `expire`. Like io_service, it's NOT thread safe
+ */
+class timer_wheel {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /** A timer, linked intrusively. Lives in its owner, e.g. an awaiter or a `timer` */
+    struct node {
+        node* next = nullptr;
+        node** pprev = nullptr;
+        uint64_t expiry = 0;
+        uint16_t slot = 0;
+        /** Called once the timer expires, after it's unlinked; may arm it again */
+        void (*fire)(node*) noexcept = nullptr;
+
+        bool armed() const noexcept {
+            return pprev;
+        }
+    };
+
+    /** @param resolution duration of a tick */
+    explicit timer_wheel(clock::duration resolution = std::chrono::milliseconds(1)) noexcept
+        : resolution(resolution)
+        , now(to_tick(clock::now())) {
+        assert(resolution.count() > 0);
+    }
+
+    timer_wheel(const timer_wheel&) = delete;
+    timer_wheel& operator =(const timer_wheel&) = delete;
+
+#ifndef NDEBUG
+    ~timer_wheel() {
+        assert(!count && "timer_wheel is destructed while timers are armed");
+    }
+#endif
+
+    /** Arm `n` to fire at `deadline`, re-arming it if it's armed already
+     * A deadline passed already fires on the next tick
+     */
+    void arm(node& n, clock::time_point deadline) noexcept {
+        if (n.armed()) unlink(n);
+        else ++count;
+        n.expiry = std::max(to_tick_ceil(deadline), now + 1);
+        insert(n);
+    }
+
+    /** Disarm `n`
+     * @return false if it isn't armed, e.g. it has fired already
+     */
+    bool cancel(node& n) noexcept {
+        if (!n.armed()) return false;
+        unlink(n);
+        --count;
+        return true;
+    }
+
+    /** Fire every timer due at `time`
+     * @return number of timers fired
+     */
+    size_t expire(clock::time_point time) noexcept {
+        uint64_t target = to_tick(time);
+        size_t fired = 0;
+        while (now < target) {
+            if (!count) {
+                now = target;
+                break;
+            }
+            uint64_t next = next_event();
+            if (next > target) {
+                now = target;
+                break;
+            }
+            now = next;
+            // Move timers down from higher levels first, some may be due at this very tick
+            for (unsigned l = levels - 1; l > 0; --l) {
+                if (now & (span(l) - 1)) continue;
+                for_each_taken(l, (now >> (bits * l)) & mask, [this] (node& n) {
+                    insert(n);
+                });
+            }
+            for_each_taken(0, now & mask, [&] (node& n) {
+                --count;
+                ++fired;
+                n.fire(&n);
+            });
+        }
+        return fired;
+    }
+
+    /** Earliest time `expire` may have work to do, clock::time_point::max() if no timer is armed
+     * @note it may be earlier than the earliest deadline, when timers have to be
+     *       moved down a level
+     */
+    clock::time_point next_wakeup() const noexcept {
+        if (!count) return clock::time_point::max();
+        return clock::time_point(resolution * int64_t(next_event()));
+    }
+
+    /** Suspend the awaiting coroutine until `deadline`
+     * The coroutine is queued by schedule_ready once the timer expires
+     * @return an awaitable, which disarms its timer if destroyed while suspended
+     */
+    auto sleep_until(clock::time_point deadline) noexcept {
+        struct await_sleep: node {
+            timer_wheel* wheel;
+            clock::time_point deadline;
+            ready_node waiter;
+
+            await_sleep(timer_wheel* wheel, clock::time_point deadline) noexcept
+                : wheel(wheel), deadline(deadline) {
+                fire = [] (node* n) noexcept {
+                    schedule_ready(static_cast<await_sleep *>(n)->waiter);
+                };
+            }
+
+            await_sleep(await_sleep&& other) noexcept: await_sleep(other.wheel, other.deadline) {
+                assert(!other.armed());
+                waiter.priority = other.waiter.priority;
+            }
+
+            /** Resume the coroutine with `priority` once the timer expires */
+            await_sleep with_priority(resume_priority priority) && noexcept {
+                waiter.priority = priority;
+                return std::move(*this);
+            }
+
+            ~await_sleep() {
+                // The coroutine is destroyed while sleeping
+                wheel->cancel(*this);
+            }
+
+            constexpr bool await_ready() const noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                waiter.handle = handle;
+                wheel->arm(*this, deadline);
+            }
+
+            constexpr void await_resume() const noexcept {}
+        };
+
+        return await_sleep(this, deadline);
+    }
+
+    /** Number of timers armed */
+    size_t size() const noexcept {
+        return count;
+    }
+
+    bool empty() const noexcept {
+        return !count;
+    }
+
+private:
+    static constexpr unsigned bits = 6;
+    static constexpr unsigned levels = 6;
+    static constexpr uint64_t slots = 1 << bits;
+    static constexpr uint64_t mask = slots - 1;
+    // Timers further than this are parked in the last slot reachable, then re-hashed
+    static constexpr uint64_t max_delta = (uint64_t(1) << (bits * levels)) - 1;
+
+    // Ticks covered by a slot of level `l`
+    static constexpr uint64_t span(unsigned l) noexcept {
+        return uint64_t(1) << (bits * l);
+    }
+
+    uint64_t to_tick(clock::time_point time) const noexcept {
+        return uint64_t(time.time_since_epoch() / resolution);
+    }
+
+    uint64_t to_tick_ceil(clock::time_point time) const noexcept {
+        if (time == clock::time_point::max()) return now + max_delta;
+        auto d = time.time_since_epoch();
+        auto tick = uint64_t(d / resolution);
+        return d % resolution != d.zero() ? tick + 1 : tick;
+    }
+
+    void insert(node& n) noexcept {
+        uint64_t delta = n.expiry > now ? n.expiry - now : 0;
+        uint64_t key = n.expiry;
+        if (delta > max_delta) {
+            delta = max_delta;
+            key = now + max_delta;
+        }
+        unsigned level = delta < slots ? 0 : (63 - __builtin_clzll(delta)) / bits;
+        unsigned index = unsigned((key >> (bits * level)) & mask);
+        n.slot = uint16_t(level * slots + index);
+
+        auto& head = heads[n.slot];
+        n.next = head;
+        if (head) head->pprev = &n.next;
+        head = &n;
+        n.pprev = &head;
+        occupied[level] |= uint64_t(1) << index;
+    }
+
+    void unlink(node& n) noexcept {
+        *n.pprev = n.next;
+        if (n.next) n.next->pprev = n.pprev;
+        n.next = nullptr;
+        n.pprev = nullptr;
+        if (!heads[n.slot]) occupied[n.slot / slots] &= ~(uint64_t(1) << (n.slot % slots));
+    }
+
+    // Take every timer of a slot, and call `fn` on each once it's unlinked. Timers
+    // taken may still be cancelled or re-armed by `fn`
+    template <typename Fn>
+    void for_each_taken(unsigned level, uint64_t index, Fn&& fn) noexcept {
+        if (!(occupied[level] & (uint64_t(1) << index))) return;
+        node* list = std::exchange(heads[level * slots + index], nullptr);
+        occupied[level] &= ~(uint64_t(1) << index);
+        list->pprev = &list;
+        while (list) {
+            auto& n = *list;
+            *n.pprev = n.next;
+            if (n.next) n.next->pprev = n.pprev;
+            n.next = nullptr;
+            n.pprev = nullptr;
+            fn(n);
+        }
+    }
+
+    // The next tick, after `now`, when a slot holding timers is reached by its level
+    uint64_t next_event() const noexcept {
+        uint64_t next = UINT64_MAX;
+        for (unsigned l = 0; l < levels; ++l) {
+            if (!occupied[l]) continue;
+            uint64_t position = (now >> (bits * l)) & mask;
+            uint64_t rotation = span(l + 1);
+            uint64_t base = now & ~(rotation - 1);
+            // Slots after the current position are reached in this rotation, others in the next one
+            uint64_t ahead = position == mask ? 0 : occupied[l] & (~uint64_t(0) << (position + 1));
+            uint64_t tick = ahead
+                ? base + (uint64_t(__builtin_ctzll(ahead)) << (bits * l))
+                : base + rotation + (uint64_t(__builtin_ctzll(occupied[l])) << (bits * l));
+            next = std::min(next, tick);
+        }
+        return next;
+    }
+
+    clock::duration resolution;
+    uint64_t now;
+    size_t count = 0;
+    std::array<uint64_t, levels> occupied {};
+    std::array<node*, levels * slots> heads {};
+};
+
+/**
+ * A timer calling a function when it expires, like a connection idle timeout
+ * Re-arming an armed timer just moves it, in O(1). The timer is disarmed when destroyed
+ * @note the function is called by io_service::run of the io_service owning the wheel
+ */
+class timer: timer_wheel::node {
+public:
+    using clock = timer_wheel::clock;
+
+    /** @param fn function to call when the timer expires, mustn't throw */
+    timer(timer_wheel& wheel, std::function<void ()> fn) noexcept
+        : wheel(&wheel), fn(std::move(fn)) {
+        fire = [] (node* n) noexcept {
+            static_cast<timer *>(n)->fn();
+        };
+    }
+
+    ~timer() {
+        cancel();
+    }
+
+    timer(const timer&) = delete;
+    timer& operator =(const timer&) = delete;
+
+    /** Arm the timer to fire at `deadline` */
+    void arm_at(clock::time_point deadline) noexcept {
+        wheel->arm(*this, deadline);
+    }
+
+    /** Arm the timer to fire after `dur` */
+    void arm_after(clock::duration dur) noexcept {
+        arm_at(clock::now() + dur);
+    }
+
+    /** Disarm the timer
+     * @return false if it isn't armed, e.g. it has fired already
+     */
+    bool cancel() noexcept {
+        return wheel->cancel(*this);
+    }
+
+    bool armed() const noexcept {
+        return node::armed();
+    }
+
+private:
+    timer_wheel* wheel;
+    std::function<void ()> fn;
+};
+
+} // namespace uio
@@ -3,6 +3,10 @@
 #include <fcntl.h>
 #include <string_view>
 #include <time.h>
+#include <version>
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+#   include <expected>
+#endif
 
 namespace uio {
 /** Fill an iovec struct using buf & size */
@@ -77,12 +81,104 @@ inline int operator |(int ret, panic_on_err&& poe) {
     }
     return ret;
 }
+
+/** Tag of `op | as_expected`, resolving with io_expected instead of a raw cqe->res */
+struct as_expected_t {};
+inline constexpr as_expected_t as_expected {};
+
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+/** Result of a request: the value of cqe->res, or the error it failed with */
+using io_expected = std::expected<int, std::errc>;
+#else
+/** Result of a request: the value of cqe->res, or the error it failed with
+ * A subset of std::expected<int, std::errc>, which it is when the standard library has it
+ * @note `value()` throws std::system_error rather than std::bad_expected_access
+ */
+class io_expected {
+public:
+    constexpr io_expected(int value = 0) noexcept: value_(value) {
+        assert(value >= 0 && "io_expected holds an error");
+    }
+
+    constexpr bool has_value() const noexcept { return value_ >= 0; }
+    constexpr explicit operator bool() const noexcept { return has_value(); }
+    constexpr int operator *() const noexcept { return value_; }
+    constexpr std::errc error() const noexcept { return std::errc(-value_); }
+    constexpr int value_or(int other) const noexcept { return has_value() ? value_ : other; }
+
+    int value() const {
+        if (!has_value()) throw std::system_error(std::make_error_code(error()));
+        return value_;
+    }
+
+private:
+    friend io_expected operator |(int ret, as_expected_t) noexcept;
+    constexpr io_expected(std::errc err, int) noexcept: value_(-int(err)) {}
+
+    // cqe->res, negative errno on failure
+    int value_;
+};
+#endif
+
+inline io_expected operator |(int ret, as_expected_t) noexcept {
+#if defined(__cpp_lib_expected) && __cpp_lib_expected >= 202202L
+    if (ret < 0) return io_expected(std::unexpect, std::errc(-ret));
+#else
+    if (ret < 0) return io_expected(std::errc(-ret), 0);
+#endif
+    return io_expected(ret);
+}
+
+// only for internal usage
+template <typename Awaiter, typename Check>
+struct checked_awaiter {
+    Awaiter awaiter;
+    Check check;
+
+    bool await_ready() { return awaiter.await_ready(); }
+
+    template <typename Promise>
+    auto await_suspend(std::coroutine_handle<Promise> handle) {
+        return awaiter.await_suspend(handle);
+    }
+
+    auto await_resume() {
+        return awaiter.await_resume() | std::move(check);
+    }
+};
+
+/**
+ * An awaitable checking the result of `op` once it's resumed, e.g. with panic_on_err
+ * No coroutine is created, and `op` is still the same request, so links are kept
+ * @warning like sqe_awaitable, the result is lost if it's not awaited
+ */
+template <typename Awaitable, typename Check>
+struct [[nodiscard]] checked_awaitable {
+    Awaitable op;
+    Check check;
+
+    auto operator co_await() {
+        if constexpr (requires { op.operator co_await(); }) {
+            return checked_awaiter<decltype(op.operator co_await()), Check> { op.operator co_await(), check };
+        } else {
+            return checked_awaiter<Awaitable&, Check> { op, check };
+        }
+    }
+};
+
+template <bool nothrow>
+inline checked_awaitable<task<int, nothrow>, panic_on_err> operator |(task<int, nothrow> tret, panic_on_err&& poe) {
+    return { std::move(tret), std::move(poe) };
+}
+inline checked_awaitable<sqe_awaitable, panic_on_err> operator |(sqe_awaitable tret, panic_on_err&& poe) noexcept {
+    return { tret, std::move(poe) };
+}
 template <bool nothrow>
-inline task<int> operator |(task<int, nothrow> tret, panic_on_err&& poe) {
-    co_return (co_await tret) | std::move(poe);
+inline checked_awaitable<task<int, nothrow>, as_expected_t> operator |(task<int, nothrow> tret, as_expected_t) {
+    return { std::move(tret), {} };
 }
-inline task<int> operator |(sqe_awaitable tret, panic_on_err&& poe) {
-    co_return (co_await tret) | std::move(poe);
+inline checked_awaitable<sqe_awaitable, as_expected_t> operator |(sqe_awaitable tret, as_expected_t) noexcept {
+    return { tret, {} };
 }
 
 } // namespace uio
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <liburing/io_service.hpp>
+#include <liburing/task.hpp>
+
+namespace uio {
+// only for internal usage
+struct when_access {
+    static io_uring_sqe* sqe(sqe_awaitable& op) noexcept { return op.sqe; }
+    static io_service* service(sqe_awaitable& op) noexcept { return op.service; }
+};
+
+// only for internal usage
+// Operations left of a when_all / when_any, plus one held by await_suspend itself, so that
+// operations finished before it returns don't resume the parent while it's suspending
+struct when_counter {
+    // The awaiting coroutine, queued to io_service once every operation is finished
+    ready_node node;
+    size_t remaining = 1;
+
+    bool release() noexcept {
+        return --remaining == 0;
+    }
+
+    void finish() noexcept {
+        if (release()) schedule_ready(node);
+    }
+};
+
+// only for internal usage
+template <typename Op>
+decltype(auto) get_awaiter(Op& op) {
+    if constexpr (requires { op.operator co_await(); }) {
+        return op.operator co_await();
+    } else {
+        return (op);
+    }
+}
+
+/** Result type of `co_await op`, std::monostate for void */
+template <typename Op>
+using await_result_t = std::conditional_t<
+    std::is_void_v<decltype(get_awaiter(std::declval<Op&>()).await_resume())>,
+    std::monostate,
+    std::decay_t<decltype(get_awaiter(std::declval<Op&>()).await_resume())>
+>;
+
+// only for internal usage
+// Any awaitable, e.g. a task, awaited by a helper coroutine
+template <typename Op>
+struct when_slot {
+    using value_type = await_result_t<Op>;
+
+    explicit when_slot(Op&& op): op(std::move(op)) {}
+
+    void start(when_counter& counter, std::exception_ptr& error) {
+        ++counter.remaining;
+        // Detached: it destroys itself once done
+        watch(*this, counter, error);
+    }
+
+    value_type take() {
+        return std::move(*value);
+    }
+
+    static task<void, true> watch(when_slot& slot, when_counter& counter, std::exception_ptr& error) {
+        try {
+            if constexpr (std::is_void_v<decltype(get_awaiter(slot.op).await_resume())>) {
+                co_await slot.op;
+                slot.value.emplace();
+            } else {
+                slot.value.emplace(co_await slot.op);
+            }
+        } catch (...) {
+            if (!error) error = std::current_exception();
+        }
+        // May destroy `slot` and `counter`, don't touch them afterwards
+        counter.finish();
+    }
+
+    Op op;
+    std::optional<value_type> value;
+};
+
+// only for internal usage
+// A request, resolved by its cqe directly without any coroutine
+template <>
+struct when_slot<sqe_awaitable> final: resolver {
+    using value_type = int;
+
+    explicit when_slot(sqe_awaitable&& op) noexcept: op(op) {}
+
+    void start(when_counter& counter, std::exception_ptr&) noexcept {
+        this->counter = &counter;
+        ++counter.remaining;
+        io_uring_sqe_set_data(when_access::sqe(op), static_cast<resolver *>(this));
+    }
+
+    void resolve(int result, uint32_t) noexcept override {
+        this->result = result;
+        counter->finish();
+    }
+
+    value_type take() noexcept {
+        return result;
+    }
+
+    sqe_awaitable op;
+    when_counter* counter = nullptr;
+    int result = 0;
+};
+
+/**
+ * Awaitable of when_all( ops... ), resolved with a tuple of every result
+ * @note it's only movable before being awaited, keep it as a temporary of `co_await`
+ */
+template <typename... Ops>
+struct when_all_awaitable {
+    explicit when_all_awaitable(Ops&&... ops): slots(std::move(ops)...) {}
+
+    when_all_awaitable(when_all_awaitable&&) = default;
+    when_all_awaitable(const when_all_awaitable&) = delete;
+    when_all_awaitable& operator =(const when_all_awaitable&) = delete;
+
+    /** Resume the awaiting coroutine with `priority` once every operation is finished */
+    when_all_awaitable with_priority(resume_priority priority) && noexcept {
+        counter.node.priority = priority;
+        return std::move(*this);
+    }
+
+    bool await_ready() const noexcept { return sizeof...(Ops) == 0; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        counter.node.handle = handle;
+        std::apply([this] (auto&... s) { (s.start(counter, error), ...); }, slots);
+        return !counter.release();
+    }
+
+    std::tuple<typename when_slot<Ops>::value_type...> await_resume() {
+        if (error) std::rethrow_exception(error);
+        return std::apply([] (auto&... s) {
+            return std::tuple<typename when_slot<Ops>::value_type...>(s.take()...);
+        }, slots);
+    }
+
+private:
+    std::tuple<when_slot<Ops>...> slots;
+    when_counter counter;
+    std::exception_ptr error;
+};
+
+/**
+ * Awaitable of when_all( std::vector<Op> ), resolved with a vector of every result
+ * @note it's only movable before being awaited, keep it as a temporary of `co_await`
+ */
+template <typename Op>
+struct when_all_range_awaitable {
+    explicit when_all_range_awaitable(std::vector<Op>&& ops) {
+        slots.reserve(ops.size());
+        for (auto& op : ops) {
+            slots.emplace_back(std::move(op));
+        }
+    }
+
+    when_all_range_awaitable(when_all_range_awaitable&&) = default;
+    when_all_range_awaitable(const when_all_range_awaitable&) = delete;
+    when_all_range_awaitable& operator =(const when_all_range_awaitable&) = delete;
+
+    /** Resume the awaiting coroutine with `priority` once every operation is finished */
+    when_all_range_awaitable with_priority(resume_priority priority) && noexcept {
+        counter.node.priority = priority;
+        return std::move(*this);
+    }
+
+    bool await_ready() const noexcept { return slots.empty(); }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        counter.node.handle = handle;
+        for (auto& s : slots) {
+            s.start(counter, error);
+        }
+        return !counter.release();
+    }
+
+    std::vector<typename when_slot<Op>::value_type> await_resume() {
+        if (error) std::rethrow_exception(error);
+        std::vector<typename when_slot<Op>::value_type> results;
+        results.reserve(slots.size());
+        for (auto& s : slots) {
+            results.push_back(s.take());
+        }
+        return results;
+    }
+
+private:
+    std::vector<when_slot<Op>> slots;
+    when_counter counter;
+    std::exception_ptr error;
+};
+
+/** Result of when_any */
+struct when_any_result {
+    /** Index of the request completed first */
+    size_t index;
+    /** Its result, like cqe->res */
+    int result;
+};
+
+/**
+ * Awaitable of when_any, `N` is std::dynamic_extent for a vector of requests
+ * @note it's only movable before being awaited, keep it as a temporary of `co_await`
+ */
+template <size_t N>
+struct when_any_awaitable {
+    template <typename Range>
+    explicit when_any_awaitable(Range&& ops) noexcept(N != std::dynamic_extent) {
+        if constexpr (N == std::dynamic_extent) slots.resize(ops.size());
+        for (size_t i = 0; i < slots.size(); ++i) {
+            slots[i].op = ops[i];
+        }
+    }
+
+    when_any_awaitable(when_any_awaitable&&) = default;
+    when_any_awaitable(const when_any_awaitable&) = delete;
+    when_any_awaitable& operator =(const when_any_awaitable&) = delete;
+
+    /** Resume the awaiting coroutine with `priority` once every operation is finished */
+    when_any_awaitable with_priority(resume_priority priority) && noexcept {
+        counter.node.priority = priority;
+        return std::move(*this);
+    }
+
+    bool await_ready() const noexcept {
+        assert(!slots.empty() && "when_any of no request");
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept {
+        counter.node.handle = handle;
+        for (size_t i = 0; i < slots.size(); ++i) {
+            auto& s = slots[i];
+            s.owner = this;
+            s.index = i;
+            ++counter.remaining;
+            io_uring_sqe_set_data(when_access::sqe(s.op), static_cast<resolver *>(&s));
+        }
+        return !counter.release();
+    }
+
+    when_any_result await_resume() const noexcept {
+        return *winner;
+    }
+
+private:
+    struct slot final: resolver {
+        sqe_awaitable op { nullptr };
+        when_any_awaitable* owner = nullptr;
+        size_t index = 0;
+        bool finished = false;
+
+        void resolve(int result, uint32_t) noexcept override {
+            finished = true;
+            owner->complete(index, result);
+        }
+    };
+
+    void complete(size_t index, int result) noexcept {
+        if (!winner) {
+            winner = when_any_result { index, result };
+            // Losers finished already in the same batch just fail to be found ( -ENOENT )
+            for (auto& s : slots) {
+                if (s.finished) continue;
+                auto* service = when_access::service(s.op);
+                assert(service && "when_any needs requests issued by io_service");
+                auto* sqe = service->io_uring_get_sqe_safe();
+                io_uring_prep_cancel(sqe, static_cast<resolver *>(&s), 0);
+                io_uring_sqe_set_data(sqe, internal_user_data);
+            }
+        }
+        counter.finish();
+    }
+
+    std::conditional_t<N == std::dynamic_extent, std::vector<slot>, std::array<slot, N>> slots;
+    when_counter counter;
+    std::optional<when_any_result> winner;
+};
+
+/** Await every operation, issued together
+ * Requests ( sqe_awaitable ) are resolved by their cqes directly, other awaitables, like
+ * tasks, are awaited by a helper coroutine each. The awaiting coroutine is resumed once,
+ * after every operation is finished. Requests are queued by the time they are passed,
+ * so they reach the kernel in one io_uring_enter
+ * @param ops operations to await, moved in
+ * @return an awaitable resolved with a tuple of results ( int for requests, std::monostate
+ *         for void ), which rethrows the first exception thrown by an operation, once all are finished
+ */
+template <typename... Ops>
+when_all_awaitable<Ops...> when_all(Ops... ops) {
+    return when_all_awaitable<Ops...>(std::move(ops)...);
+}
+
+/** Await every operation of a vector, issued together
+ * @see when_all( ops... )
+ * @return an awaitable resolved with a vector of results, in the order of `ops`
+ */
+template <typename Op>
+when_all_range_awaitable<Op> when_all(std::vector<Op> ops) {
+    return when_all_range_awaitable<Op>(std::move(ops));
+}
+
+/** Await the request completed first, cancelling the others
+ * Requests left are cancelled by IORING_OP_ASYNC_CANCEL once one completes. The awaiting
+ * coroutine is resumed after every request is finished, since they refer to the awaitable
+ * @param ops requests issued by io_service, e.g. reads on different fds
+ * @return an awaitable resolved with the index and result of the first completion, which
+ *         may be an error
+ */
+template <typename... Ops>
+    requires (std::is_same_v<Ops, sqe_awaitable> && ...)
+when_any_awaitable<sizeof...(Ops)> when_any(Ops... ops) noexcept {
+    return when_any_awaitable<sizeof...(Ops)>(std::array<sqe_awaitable, sizeof...(Ops)> { ops... });
+}
+
+/** Await the request of a vector completed first, cancelling the others
+ * @see when_any( ops... )
+ */
+inline when_any_awaitable<std::dynamic_extent> when_any(const std::vector<sqe_awaitable>& ops) {
+    return when_any_awaitable<std::dynamic_extent>(ops);
+}
+
+} // namespace uio
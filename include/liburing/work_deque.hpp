@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+
+namespace uio {
+/**
+ * A bounded Chase-Lev work-stealing deque
+ * The owner thread pushes and pops at the bottom (LIFO), any other thread steals
+ * from the top (FIFO). All operations are lock free.
+ * @see "Correct and Efficient Work-Stealing for Weak Memory Models", Lê et al., PPoPP 2013
+ * @tparam T a trivially copyable item, e.g. a pointer
+ */
+template <typename T>
+class work_deque {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    /** @param capacity maximum number of items, must be a power of 2 */
+    explicit work_deque(size_t capacity = 1024)
+        : mask(int64_t(capacity) - 1)
+        , buffer(new std::atomic<T>[capacity]) {
+        assert(capacity && (capacity & (capacity - 1)) == 0 && "capacity must be a power of 2");
+    }
+
+    work_deque(const work_deque&) = delete;
+    work_deque& operator =(const work_deque&) = delete;
+
+    /** Push an item at the bottom, owner only
+     * @return false if the deque is full
+     */
+    bool push(T item) noexcept {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        if (b - t > mask) return false;
+        buffer[b & mask].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /** Pop the newest item, owner only */
+    std::optional<T> pop() noexcept {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // Empty
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        T item = buffer[b & mask].load(std::memory_order_relaxed);
+        if (t == b) {
+            // The last item, race against thieves
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            if (!won) return std::nullopt;
+        }
+        return item;
+    }
+
+    /** Steal the oldest item, any thread */
+    std::optional<T> steal() noexcept {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t >= b) return std::nullopt;
+        T item = buffer[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            // Lost the race against the owner or another thief
+            return std::nullopt;
+        }
+        return item;
+    }
+
+    /** Number of items, only a hint when called by a thief */
+    size_t size() const noexcept {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? size_t(b - t) : 0;
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+private:
+    // Owner and thieves write different ends, keep them on different cache lines
+    alignas(64) std::atomic<int64_t> top = 0;
+    alignas(64) std::atomic<int64_t> bottom = 0;
+    int64_t mask;
+    std::unique_ptr<std::atomic<T>[]> buffer;
+};
+
+} // namespace uio
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <functional>
+#include <utility>
+#include <liburing.h>
+
+#include <liburing/stdlib_coroutine.hpp>
+#include <liburing/sqe_awaitable.hpp>
+
+namespace uio {
+/** Resolver of a zero-copy send, which is completed twice:
+ * the result cqe (with IORING_CQE_F_MORE), then the notification cqe (IORING_CQE_F_NOTIF)
+ * telling that the kernel doesn't reference the buffer anymore.
+ * It's heap allocated and owned by a zc_awaitable; once detached, it deletes
+ * itself when both cqes are posted
+ */
+struct zc_resolver final: resolver {
+    friend struct zc_awaitable;
+
+    void resolve(int result, uint32_t flags) noexcept override {
+        if (flags & IORING_CQE_F_NOTIF) {
+            release();
+        } else {
+            this->result = result;
+            completed = true;
+            // No notification follows if the send failed before referencing the buffer
+            if (!(flags & IORING_CQE_F_MORE)) release();
+        }
+
+        if (detached) {
+            if (notified) delete this;
+            return;
+        }
+        // NOTE: the consumer may destroy its zc_awaitable when resumed in place. Don't touch `this`
+        // afterwards. Both nodes live in awaiters, so the one waiting for the release goes last
+        auto* w = completed ? std::exchange(waiter, nullptr) : nullptr;
+        auto* r = notified ? std::exchange(release_waiter, nullptr) : nullptr;
+        if (w) schedule_ready(*w);
+        if (r) schedule_ready(*r);
+    }
+
+private:
+    void release() noexcept {
+        notified = true;
+        // The callback is queued like a coroutine, and deletes itself once run
+        if (on_released) std::exchange(on_released, nullptr)->resolve(0, 0);
+    }
+
+    // Nodes of the coroutines waiting for each cqe, in their awaiters
+    ready_node* waiter = nullptr;
+    ready_node* release_waiter = nullptr;
+    // Heap allocated, it outlives this resolver when queued
+    callback_resolver* on_released = nullptr;
+    int result = 0;
+    bool completed = false;
+    bool notified = false;
+    bool detached = false;
+};
+
+/**
+ * An awaitable object of a zero-copy send
+ * co_await returns bytes sent (or -errno) as soon as the result cqe arrives.
+ * The buffer must be kept unchanged until `released()` is resolved.
+ * @note It's safe to destroy this object earlier; the buffer is still in use
+ *       until the notification arrives, see `set_callback`
+ */
+struct zc_awaitable {
+    zc_awaitable(io_uring_sqe* sqe) : resolver(new zc_resolver()) {
+        io_uring_sqe_set_data(sqe, static_cast<uio::resolver *>(resolver));
+    }
+
+    zc_awaitable(zc_awaitable&& other) noexcept
+        : resolver(std::exchange(other.resolver, nullptr)), priority(other.priority) {}
+    zc_awaitable(const zc_awaitable&) = delete;
+    zc_awaitable& operator =(const zc_awaitable&) = delete;
+
+    ~zc_awaitable() {
+        if (!resolver) return;
+        if (resolver->completed && resolver->notified) {
+            delete resolver;
+        } else {
+            resolver->waiter = nullptr;
+            resolver->release_waiter = nullptr;
+            resolver->detached = true;
+        }
+    }
+
+    /** Is the buffer no longer referenced by the kernel */
+    bool is_released() const noexcept {
+        return resolver->notified;
+    }
+
+    /** Call `cb` once the buffer is no longer referenced by the kernel,
+     * even if this object has been destroyed by then. It's queued with `priority`
+     * through the ready queue, like the coroutines awaiting `released()`
+     */
+    void set_callback(std::function<void ()> cb) {
+        auto* node = new callback_resolver([cb = std::move(cb)] (int) { cb(); }, priority);
+        if (resolver->notified) {
+            node->resolve(0, 0);
+        } else {
+            delete std::exchange(resolver->on_released, node);
+        }
+    }
+
+    /** Resume the coroutines awaiting the send or the release with `priority`
+     * @return this object
+     */
+    zc_awaitable& with_priority(resume_priority priority) & noexcept {
+        this->priority = priority;
+        return *this;
+    }
+    zc_awaitable&& with_priority(resume_priority priority) && noexcept {
+        this->priority = priority;
+        return std::move(*this);
+    }
+
+    auto operator co_await() noexcept {
+        struct await_zc {
+            zc_resolver* resolver;
+            ready_node node;
+
+            bool await_ready() const noexcept { return resolver->completed; }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                node.handle = handle;
+                resolver->waiter = &node;
+            }
+
+            int await_resume() const noexcept { return resolver->result; }
+        };
+
+        return await_zc { resolver, { .priority = priority } };
+    }
+
+    /** Awaitable resolved when the buffer is no longer referenced by the kernel */
+    auto released() noexcept {
+        struct await_release {
+            zc_resolver* resolver;
+            ready_node node;
+
+            bool await_ready() const noexcept { return resolver->notified; }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept {
+                node.handle = handle;
+                resolver->release_waiter = &node;
+            }
+
+            constexpr void await_resume() const noexcept {}
+        };
+
+        return await_release { resolver, { .priority = priority } };
+    }
+
+private:
+    zc_resolver* resolver;
+    resume_priority priority = resume_priority::normal;
+};
+
+} // namespace uio
@@ -0,0 +1,67 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <liburing/async_generator.hpp>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Chunks of a file, read one request at a time
+auto read_chunks(uio::io_service& service, int fd, size_t chunk_size) -> uio::async_generator<std::string_view> {
+    std::array<char, 64> buffer;
+    while (true) {
+        int res = co_await service.read(fd, buffer.data(), std::min(chunk_size, buffer.size()), 0);
+        res | uio::panic_on_err("read", false);
+        if (res == 0) co_return;
+        co_yield std::string_view(buffer.data(), size_t(res));
+    }
+}
+
+auto count_to(int n) -> uio::async_generator<int> {
+    for (int i = 1; i <= n; i++) {
+        co_yield i;
+    }
+    throw std::runtime_error("expected");
+}
+
+auto test(uio::io_service& service, int read_fd) -> uio::task<> {
+    std::string content;
+    int chunks = 0;
+    auto gen = read_chunks(service, read_fd, 4);
+    for (auto it = co_await gen.begin(); it != gen.end(); co_await ++it) {
+        content += *it;
+        chunks++;
+    }
+    fmt::print("Read {} in {} chunks\n", content, chunks);
+    if (content != "hello generator" || chunks != 4)
+        throw std::runtime_error("async_generator: unexpected content");
+
+    int sum = 0;
+    bool thrown = false;
+    auto counter = count_to(10);
+    try {
+        while (auto* i = co_await counter.next()) {
+            sum += *i;
+        }
+    } catch (std::runtime_error&) {
+        thrown = true;
+    }
+    if (sum != 55 || !thrown || !counter.done())
+        throw std::runtime_error("async_generator: unexpected count");
+}
+
+int main() {
+    uio::io_service service;
+
+    std::array<int, 2> p;
+    pipe(p.data()) | uio::panic_on_err("Unable to open pipe", true);
+    uio::on_scope_exit closepipe([&]() { close(p[0]); });
+
+    std::string_view msg = "hello generator";
+    write(p[1], msg.data(), msg.size()) | uio::panic_on_err("write", true);
+    close(p[1]);
+
+    service.run(test(service, p[0]));
+}
@@ -0,0 +1,42 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <liburing/blocking_pool.hpp>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+int main() {
+    uio::io_service service;
+    uio::blocking_pool pool(4);
+    int finished = 0;
+
+    auto compute = [&] (int i) -> uio::task<> {
+        auto tid = gettid();
+        int result = co_await pool.run(service, [=] {
+            if (gettid() == tid) uio::panic("Function ran on the calling thread", 0);
+            return i * i;
+        });
+        if (gettid() != tid) uio::panic("Coroutine resumed on another thread", 0);
+        if (result != i * i) uio::panic("Unexpected result", 0);
+        ++finished;
+    };
+
+    service.run([&] () -> uio::task<> {
+        // Many calls in flight at once
+        std::vector<uio::task<>> tasks;
+        for (int i = 0; i < 100; i++) tasks.push_back(compute(i));
+        for (auto& t : tasks) co_await t;
+
+        bool caught = false;
+        try {
+            co_await pool.run(service, [] { throw std::runtime_error("oops"); });
+        } catch (std::runtime_error&) {
+            caught = true;
+        }
+        if (!caught) uio::panic("Exception is lost", 0);
+    }());
+
+    fmt::print("{} calls finished\n", finished);
+    if (finished != 100) uio::panic("Unexpected result", 0);
+}
@@ -0,0 +1,34 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <string_view>
+
+auto read_all(uio::io_service& service, uio::buffer_ring& buffers, int read_fd, int write_fd) -> uio::task<> {
+    std::string_view msg = "hello!";
+
+    // Loop more times than there are buffers to make sure they're recycled
+    for (int i = 0; i < 16; i++) {
+        co_await service.write(write_fd, msg.data(), msg.size(), 0)
+            | uio::panic_on_err("Unable to write to write_fd", false);
+
+        auto buf = co_await service.read(read_fd, buffers, 0);
+        buf.result() | uio::panic_on_err("Unable to read from read_fd", false);
+
+        fmt::print("Recieved {} in buffer {}\n", buf.view(), buf.buffer_id());
+        if (!buf || buf.view() != msg)
+            uio::panic("Unexpected message", 0);
+    }
+}
+
+int main() {
+    using uio::io_service;
+
+    io_service service;
+    uio::buffer_ring buffers(service.get_handle(), 4, 64);
+
+    std::array<int, 2> p;
+    pipe(p.data()) | uio::panic_on_err("Unable to open pipe", true);
+    uio::on_scope_exit closepipe([&]() { close(p[0]); close(p[1]); });
+
+    service.run(read_all(service, buffers, p[0], p[1]));
+}
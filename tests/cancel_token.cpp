@@ -0,0 +1,48 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <liburing/cancel_token.hpp>
+
+using namespace std::literals;
+
+auto cancel_later(uio::io_service& service, uio::cancel_token& token) -> uio::task<> {
+    auto ts = uio::dur2ts(100ms);
+    co_await service.timeout(&ts);
+    fmt::print("Cancelling token\n");
+    token.cancel();
+}
+
+auto read_nothing(uio::io_service& service, int read_fd) -> uio::task<> {
+    std::array<char, 64> buffer;
+
+    // Nothing is ever written to the pipe, so both reads can only be cancelled
+    int res = co_await uio::with_timeout(service.read(read_fd, buffer.data(), buffer.size(), 0), 100ms);
+    fmt::print("with_timeout: {}\n", res);
+    if (res != -ECANCELED)
+        throw std::runtime_error("with_timeout: read is not cancelled");
+
+    uio::cancel_token token(service);
+    auto canceller = cancel_later(service, token);
+    res = co_await uio::with_cancel(service.read(read_fd, buffer.data(), buffer.size(), 0), token);
+    fmt::print("with_cancel: {}\n", res);
+    if (res != -ECANCELED || !token.cancelled())
+        throw std::runtime_error("with_cancel: read is not cancelled");
+    co_await canceller;
+
+    // Requests attached to a cancelled token are cancelled immediately
+    res = co_await uio::with_cancel(service.read(read_fd, buffer.data(), buffer.size(), 0), token);
+    if (res != -ECANCELED)
+        throw std::runtime_error("with_cancel: read is not cancelled");
+}
+
+int main() {
+    using uio::io_service;
+
+    io_service service;
+
+    std::array<int, 2> p;
+    pipe(p.data()) | uio::panic_on_err("Unable to open pipe", true);
+    uio::on_scope_exit closepipe([&]() { close(p[0]); close(p[1]); });
+
+    service.run(read_nothing(service, p[0]));
+}
@@ -0,0 +1,98 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <liburing/channel.hpp>
+#include <liburing/runtime.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Pipeline on one ring: producers block on a small buffer, items arrive in order
+void test_single_ring() {
+    uio::io_service service;
+    uio::channel<std::unique_ptr<int>> parsed(2);
+    uio::channel<int> routed(1);
+    std::vector<int> received;
+
+    auto parse = [&] () -> uio::task<> {
+        for (int i = 0; i < 100; i++) {
+            if (!co_await parsed.send(std::make_unique<int>(i))) uio::panic("channel closed early", 0);
+            if (i % 7 == 0) co_await service.yield();
+        }
+        parsed.close();
+    };
+    auto route = [&] () -> uio::task<> {
+        while (auto item = co_await parsed.recv()) {
+            co_await routed.send(**item * 2);
+        }
+        routed.close();
+    };
+    auto respond = [&] () -> uio::task<> {
+        while (auto item = co_await routed.recv()) {
+            received.push_back(*item);
+        }
+    };
+
+    service.run([&] () -> uio::task<> {
+        auto r = respond();
+        auto t = route();
+        auto p = parse();
+        co_await p;
+        co_await t;
+        co_await r;
+    }());
+
+    if (received.size() != 100) uio::panic("Unexpected item count", received.size());
+    for (int i = 0; i < 100; i++) {
+        if (received[i] != i * 2) uio::panic("Unexpected item", i);
+    }
+    auto late = std::make_unique<int>(0);
+    if (parsed.try_send(late) || !late) uio::panic("Sent to a closed channel", 0);
+}
+
+// Producers and consumers on different rings
+void test_cross_ring() {
+    if (!uio::io_service().is_supported(IORING_OP_MSG_RING)) {
+        fmt::print("IORING_OP_MSG_RING is not supported, skipping\n");
+        return;
+    }
+
+    constexpr int per_producer = 10000;
+    uio::cross_ring_channel<int> ch(8);
+    std::atomic<long> sum = 0;
+    std::atomic<int> received = 0, producers = 2, finished = 0;
+    {
+        uio::runtime rt(uio::runtime_options { .threads = 4 });
+        for (size_t i = 0; i < 2; i++) {
+            rt.spawn_on(i, [&] (uio::io_service& service) -> uio::task<> {
+                for (int j = 1; j <= per_producer; j++) {
+                    co_await ch.send(service, j);
+                }
+                if (--producers == 0) ch.close(service);
+                ++finished;
+            });
+        }
+        for (size_t i = 2; i < 4; i++) {
+            rt.spawn_on(i, [&] (uio::io_service& service) -> uio::task<> {
+                while (auto item = co_await ch.recv(service)) {
+                    sum += *item;
+                    ++received;
+                }
+                ++finished;
+            });
+        }
+        while (finished != 4) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    fmt::print("received: {}, sum: {}\n", received.load(), sum.load());
+    if (received != 2 * per_producer || sum != 2L * per_producer * (per_producer + 1) / 2) {
+        uio::panic("Unexpected result", 0);
+    }
+}
+
+int main() {
+    test_single_ring();
+    test_cross_ring();
+}
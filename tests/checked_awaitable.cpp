@@ -0,0 +1,52 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <array>
+#include <stdexcept>
+#include <string_view>
+
+auto write_twice(uio::io_service& service, int fd, std::string_view msg) -> uio::task<int> {
+    int a = co_await service.write(fd, msg.data(), msg.size(), 0);
+    int b = co_await service.write(fd, msg.data(), msg.size(), 0);
+    co_return a + b;
+}
+
+auto test(uio::io_service& service, int read_fd, int write_fd) -> uio::task<> {
+    using uio::panic_on_err;
+    std::array<char, 16> buffer;
+
+    // The check runs when the request is resumed, no coroutine is created for it
+    auto checked = service.write(write_fd, "ping", 4, 0) | panic_on_err("write", false);
+    int written = co_await checked;
+    written += co_await (write_twice(service, write_fd, "pong") | panic_on_err("write_twice", false));
+    int n = co_await (service.read(read_fd, buffer.data(), buffer.size(), 0) | panic_on_err("read", false));
+    fmt::print("written: {}, read: {}\n", written, n);
+    if (written != 12 || n != 12)
+        throw std::runtime_error("panic_on_err: unexpected result");
+
+    bool thrown = false;
+    try {
+        co_await (service.read(-1, buffer.data(), buffer.size(), 0) | panic_on_err("read", false));
+    } catch (std::system_error& e) {
+        thrown = e.code().value() == EBADF;
+    }
+    if (!thrown) throw std::runtime_error("panic_on_err: error is not thrown");
+
+    // Nothrow flavour
+    uio::io_expected res = co_await (service.read(-1, buffer.data(), buffer.size(), 0) | uio::as_expected);
+    if (res || res.error() != std::errc::bad_file_descriptor)
+        throw std::runtime_error("as_expected: unexpected result");
+    res = co_await (service.write(write_fd, "ping", 4, 0) | uio::as_expected);
+    if (!res || *res != 4)
+        throw std::runtime_error("as_expected: unexpected result");
+}
+
+int main() {
+    uio::io_service service;
+
+    std::array<int, 2> p;
+    pipe(p.data()) | uio::panic_on_err("Unable to open pipe", true);
+    uio::on_scope_exit closepipe([&]() { close(p[0]); close(p[1]); });
+
+    service.run(test(service, p[0], p[1]));
+}
@@ -0,0 +1,41 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+int main() {
+    using uio::panic_on_err;
+
+    uio::io_service service;
+    // Two slices per region, so that the pool has to grow
+    uio::fixed_buffer_pool pool(service.get_handle(), { .slice_size = 64, .slices_per_region = 2, .max_regions = 3 });
+
+    service.run([&] () -> uio::task<> {
+        int fds[2];
+        ::pipe(fds) | panic_on_err("pipe", true);
+
+        std::vector<uio::fixed_buffer> bufs;
+        for (int i = 0; i < 6; i++) bufs.push_back(pool.acquire());
+        if (pool.region_count() != 3 || pool.available() != 0) uio::panic("Unexpected pool state", pool.region_count());
+        if (pool.try_acquire()) uio::panic("Acquired more slices than the pool has", 0);
+
+        for (size_t i = 0; i < bufs.size(); i++) {
+            auto& buf = bufs[i];
+            int n = fmt::format_to_n(buf.data(), buf.size(), "slice {} of buffer {}", i, buf.buf_index()).size;
+            co_await service.write_fixed(fds[1], buf, n, 0) | panic_on_err("write_fixed", false);
+
+            // Read back into another region
+            auto& other = bufs[(i + 2) % bufs.size()];
+            int m = co_await service.read_fixed(fds[0], other, 0) | panic_on_err("read_fixed", false);
+            if (other.view(m) != buf.view(n)) uio::panic("Unexpected data", i);
+        }
+
+        bufs.clear();
+        if (pool.available() != 6) uio::panic("Slices aren't given back", pool.available());
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }());
+    fmt::print("Fixed buffer pool works\n");
+}
@@ -0,0 +1,80 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <liburing/fixed_file_table.hpp>
+#include <optional>
+#include <string_view>
+#include <sys/socket.h>
+
+int main() {
+    using uio::panic_on_err;
+
+    uio::io_service service;
+    if (!service.is_supported(IORING_OP_SOCKET)) {
+        fmt::print("Direct descriptor allocation is not supported, skipping\n");
+        return 0;
+    }
+
+    std::optional<uio::fixed_file_table> files;
+    try {
+        files.emplace(service, 8, 2);
+    } catch (const std::system_error& e) {
+        fmt::print("Sparse file table is not supported ({}), skipping\n", e.what());
+        return 0;
+    }
+
+    service.run([&] () -> uio::task<> {
+        // Reserved slots: fds opened elsewhere
+        int fds[2];
+        ::pipe(fds) | panic_on_err("pipe", true);
+        auto rd = files->install(fds[0]);
+        auto wr = files->install(fds[1]);
+        ::close(fds[0]);
+        ::close(fds[1]);
+        if (files->available() != 0) uio::panic("Unexpected available slots", files->available());
+
+        std::string_view msg = "ping";
+        char buf[16];
+        for (int i = 0; i < 100; i++) {
+            co_await service.write(wr, msg.data(), msg.size(), 0) | panic_on_err("write", false);
+            int n = co_await service.read(rd, buf, sizeof(buf), 0) | panic_on_err("read", false);
+            if (std::string_view(buf, n) != msg) uio::panic("Unexpected message", 0);
+        }
+        files->remove(rd);
+        files->remove(wr);
+        if (files->available() != 2) uio::panic("Slots aren't freed", files->available());
+
+        // Slots allocated by the kernel, never below the reserved ones
+        int index = co_await service.openat_direct(AT_FDCWD, "/dev/null", O_RDONLY, 0) | panic_on_err("openat_direct", false);
+        if (index < 2) uio::panic("Kernel allocated a reserved slot", index);
+        uio::fixed_fd null(index);
+        if (co_await service.read(null, buf, sizeof(buf), 0) != 0) uio::panic("Unexpected read from /dev/null", 0);
+        co_await service.close(null) | panic_on_err("close", false);
+
+        for (int i = 0; i < 20; i++) {
+            // Closed descriptors free their slots, so this never runs out
+            int sock = co_await service.socket_direct(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket_direct", false);
+            co_await service.close(uio::fixed_fd(sock)) | panic_on_err("close", false);
+        }
+    }());
+
+    // Every slot reserved: the kernel has none to allocate, install still has them
+    files.reset();
+    files.emplace(service, 2, 2);
+    service.run([&] () -> uio::task<> {
+        int index = co_await service.openat_direct(AT_FDCWD, "/dev/null", O_RDONLY, 0);
+        if (index >= 0) {
+            fmt::print("File allocation range is not supported, the kernel allocated slot {}\n", index);
+            co_await service.close(uio::fixed_fd(index)) | panic_on_err("close", false);
+        } else if (index != -ENFILE) {
+            uio::panic("openat_direct", -index);
+        }
+        int fd = ::open("/dev/null", O_RDONLY) | panic_on_err("open", true);
+        auto null = files->install(fd);
+        ::close(fd);
+        char buf[16];
+        if (co_await service.read(null, buf, sizeof(buf), 0) != 0) uio::panic("Unexpected read from /dev/null", 0);
+        files->remove(null);
+    }());
+    fmt::print("Fixed file table works\n");
+}
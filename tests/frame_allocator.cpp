@@ -0,0 +1,85 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+// Counts calls, and hands every block to malloc
+struct counting_allocator final: uio::frame_allocator {
+    void* allocate(size_t size) override {
+        ++allocated;
+        return std::malloc(size);
+    }
+
+    void deallocate(void* ptr, size_t) noexcept override {
+        ++deallocated;
+        std::free(ptr);
+    }
+
+    int allocated = 0;
+    int deallocated = 0;
+};
+
+auto yield_once(uio::io_service& service) -> uio::task<> {
+    co_await service.yield();
+}
+
+void run_all(uio::io_service& service, std::vector<uio::task<>>& tasks) {
+    service.run_until([&] {
+        for (auto& t : tasks) {
+            if (!t.done()) return false;
+        }
+        return true;
+    });
+}
+
+int main() {
+    uio::io_service service;
+
+    // A freed block is handed out again for a frame of the same size class
+    {
+        uio::frame_pool pool;
+        void* a = pool.allocate(100);
+        pool.deallocate(a, 100);
+        void* b = pool.allocate(120);
+        if (a != b) throw std::runtime_error("frame_pool: block is not reused");
+        pool.deallocate(b, 120);
+    }
+
+    // Every suspended task holds a frame until it's finished and destroyed
+    constexpr int count = 100;
+    auto base = uio::get_frame_stats();
+    {
+        std::vector<uio::task<>> tasks;
+        for (int i = 0; i < count; i++) {
+            tasks.push_back(yield_once(service));
+        }
+        auto stats = uio::get_frame_stats();
+        fmt::print("live: {}, peak: {}\n", stats.live - base.live, stats.peak);
+        if (stats.live != base.live + count || stats.peak != std::max(base.peak, base.live + count))
+            throw std::runtime_error("frame_stats: unexpected counters");
+        run_all(service, tasks);
+    }
+    if (uio::get_frame_stats().live != base.live)
+        throw std::runtime_error("frame_stats: frames are leaked");
+
+    // Frames go back to the allocator creating them, even after it's replaced
+    counting_allocator allocator;
+    {
+        std::vector<uio::task<>> tasks;
+        uio::set_frame_allocator(&allocator);
+        for (int i = 0; i < count; i++) {
+            tasks.push_back(yield_once(service));
+        }
+        uio::set_frame_allocator(nullptr);
+        tasks.push_back(yield_once(service));
+        run_all(service, tasks);
+    }
+    fmt::print("allocated: {}, deallocated: {}\n", allocator.allocated, allocator.deallocated);
+    if (allocator.allocated != count || allocator.deallocated != count)
+        throw std::runtime_error("set_frame_allocator: unmatched calls");
+    if (uio::get_frame_stats().live != base.live)
+        throw std::runtime_error("frame_stats: frames are leaked");
+}
@@ -0,0 +1,49 @@
+#include <fmt/core.h>
+
+#include <liburing/runtime.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+int main() {
+    using namespace std::chrono_literals;
+
+    std::atomic<int> hops = 0;
+    std::atomic<bool> posted = false;
+    {
+        uio::runtime rt(uio::runtime_options { .threads = 2 });
+
+        rt.spawn_on(0, [&] (uio::io_service& service) -> uio::task<> {
+            if (!service.is_supported(IORING_OP_MSG_RING)) {
+                fmt::print("IORING_OP_MSG_RING is not supported, skipping\n");
+                hops = 10;
+                posted = true;
+                co_return;
+            }
+
+            // Bounce between both workers, checking that we land on the expected thread
+            auto* current = &service;
+            for (int i = 0; i < 10; i++) {
+                auto* target = &rt.service(current == &rt.service(0) ? 1 : 0);
+                auto tid = gettid();
+                co_await current->schedule_on(*target) | uio::panic_on_err("schedule_on", false);
+                if (gettid() == tid) uio::panic("schedule_on didn't move the coroutine", 0);
+                current = target;
+                ++hops;
+            }
+
+            auto tid = gettid();
+            current->post(rt.service(0), [&, tid] {
+                fmt::print("Posted from thread {} to thread {}\n", tid, gettid());
+                posted = true;
+            });
+        });
+
+        for (int i = 0; i < 100 && !posted; i++) {
+            std::this_thread::sleep_for(10ms);
+        }
+    }
+
+    if (hops != 10 || !posted)
+        uio::panic("Unexpected result", 0);
+}
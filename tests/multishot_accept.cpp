@@ -0,0 +1,58 @@
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+
+auto accept_all(uio::io_service& service, int serverfd, int count) -> uio::task<> {
+    auto connections = service.accept_multishot(serverfd, nullptr, nullptr);
+
+    for (int i = 0; i < count; i++) {
+        int clientfd = co_await connections | uio::panic_on_err("accept_multishot", false);
+        fmt::print("accepted sockfd {}\n", clientfd);
+        co_await service.close(clientfd);
+    }
+
+    if (!connections.armed())
+        throw std::runtime_error("accept_multishot: stream terminated early");
+
+    connections.cancel();
+    // Drain until the kernel posts the final cqe
+    while (co_await connections >= 0) {}
+
+    if (connections.armed())
+        throw std::runtime_error("accept_multishot: stream still armed after cancel");
+}
+
+int main() {
+    using uio::io_service;
+    using uio::panic_on_err;
+    using uio::on_scope_exit;
+
+    io_service service;
+
+    int serverfd = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
+    on_scope_exit closesock([=]() { close(serverfd); });
+
+    sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr = { htonl(INADDR_LOOPBACK) },
+        .sin_zero = {},
+    };
+    socklen_t addrlen = sizeof (addr);
+    bind(serverfd, reinterpret_cast<sockaddr *>(&addr), addrlen) | panic_on_err("bind", true);
+    listen(serverfd, 16) | panic_on_err("listen", true);
+    getsockname(serverfd, reinterpret_cast<sockaddr *>(&addr), &addrlen) | panic_on_err("getsockname", true);
+
+    // Loopback connections complete in the backlog, so connecting first is fine
+    std::array<int, 3> clients;
+    for (auto& clientfd : clients) {
+        clientfd = socket(AF_INET, SOCK_STREAM, 0) | panic_on_err("socket creation", true);
+        connect(clientfd, reinterpret_cast<sockaddr *>(&addr), addrlen) | panic_on_err("connect", true);
+    }
+    on_scope_exit closeclients([&]() { for (int clientfd : clients) close(clientfd); });
+
+    service.run(accept_all(service, serverfd, int(clients.size())));
+}
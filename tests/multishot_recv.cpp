@@ -0,0 +1,47 @@
+#include <sys/socket.h>
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <string_view>
+
+auto recv_all(uio::io_service& service, uio::buffer_ring& buffers, int sockfd, int count) -> uio::task<> {
+    std::string_view expected = "ping!";
+    auto messages = service.recv_multishot(sockfd, buffers, 0);
+
+    // There are more messages than buffers; the stream must re-arm on ENOBUFS
+    for (int i = 0; i < count; i++) {
+        auto buf = co_await messages;
+        buf.result() | uio::panic_on_err("recv_multishot", false);
+
+        fmt::print("Recieved {} in buffer {}\n", buf.view(), buf.buffer_id());
+        if (buf.view() != expected)
+            uio::panic("Unexpected message", 0);
+    }
+
+    // The peer is closed, so the stream ends with EOF
+    if (auto buf = co_await messages; buf.result() != 0)
+        throw std::runtime_error("recv_multishot: EOF expected");
+    if (messages.armed())
+        throw std::runtime_error("recv_multishot: stream still armed after EOF");
+}
+
+int main() {
+    using uio::io_service;
+    using uio::panic_on_err;
+
+    io_service service;
+    uio::buffer_ring buffers(service.get_handle(), 4, 64);
+
+    std::array<int, 2> sv;
+    socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv.data()) | panic_on_err("socketpair", true);
+    uio::on_scope_exit closesock([&]() { close(sv[0]); });
+
+    const int count = 10;
+    std::string_view msg = "ping!";
+    for (int i = 0; i < count; i++) {
+        send(sv[1], msg.data(), msg.size(), 0) | panic_on_err("send", true);
+    }
+    close(sv[1]);
+
+    service.run(recv_all(service, buffers, sv[0], count));
+}
@@ -0,0 +1,55 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+auto yield_with(uio::io_service& service, uio::resume_priority priority, int id, std::vector<int>& order) -> uio::task<> {
+    co_await service.yield().with_priority(priority);
+    order.push_back(id);
+}
+
+auto sleep_with(uio::io_service& service, uio::timer_wheel::clock::time_point deadline, uio::resume_priority priority, int id, std::vector<int>& order) -> uio::task<> {
+    co_await service.sleep_until(deadline).with_priority(priority);
+    order.push_back(id);
+}
+
+int main() {
+    // At most 4 coroutines resumed per loop iteration
+    uio::io_service service(uio::io_service_options { .resume_budget = 4 });
+    std::vector<int> order;
+    std::vector<uio::task<>> tasks;
+
+    // Nops complete on submission, so every cqe is reaped in the same batch
+    for (int i = 0; i < 16; i++) {
+        auto priority = i % 2 ? uio::resume_priority::bulk : uio::resume_priority::control;
+        tasks.push_back(yield_with(service, priority, i, order));
+    }
+    service.run_once();
+    fmt::print("resumed: {}, ready: {}\n", order.size(), service.ready_size());
+    if (order.size() > 4) throw std::runtime_error("ready_queue: budget exceeded");
+
+    service.run_until([&] { return order.size() == 16; });
+    // Control coroutines first, in completion order
+    for (int i = 0; i < 16; i++) {
+        int expected = i < 8 ? i * 2 : (i - 8) * 2 + 1;
+        if (order[i] != expected) throw std::runtime_error("ready_queue: unexpected order");
+    }
+
+    // Expired sleeps go through the same queue, so do callbacks
+    order.clear();
+    tasks.clear();
+    auto deadline = uio::timer_wheel::clock::now() + std::chrono::milliseconds(5);
+    for (int i = 0; i < 4; i++) {
+        tasks.push_back(sleep_with(service, deadline, uio::resume_priority::bulk, i, order));
+    }
+    tasks.push_back(sleep_with(service, deadline, uio::resume_priority::control, 4, order));
+    service.yield().with_priority(uio::resume_priority::control).set_callback([&] (int) {
+        order.push_back(5);
+    });
+    service.run_until([&] { return order.size() == 6; });
+    // The callback runs as soon as its nop completes, then sleeps expiring together by priority
+    fmt::print("order: {} {} {}\n", order[0], order[1], order[2]);
+    if (order[0] != 5 || order[1] != 4) throw std::runtime_error("ready_queue: sleep is not queued by priority");
+}
@@ -0,0 +1,58 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <chrono>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+
+using namespace std::literals;
+
+auto yield_then_count(uio::io_service& service, int& count) -> uio::task<> {
+    co_await service.yield();
+    ++count;
+}
+
+auto sleep_then_count(uio::io_service& service, std::chrono::milliseconds dur, int& count) -> uio::task<> {
+    co_await service.sleep_for(dur);
+    ++count;
+}
+
+int main() {
+    uio::io_service service;
+    int count = 0;
+
+    // Nothing to do, poll returns at once
+    if (service.poll() != 0) throw std::runtime_error("poll: unexpected cqe");
+
+    auto yielded = yield_then_count(service, count);
+    while (count == 0) service.run_once();
+
+    // run_for returns on time, even with nothing completing
+    auto start = std::chrono::steady_clock::now();
+    service.run_for(20ms);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    fmt::print("run_for(20ms): {}us\n", std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    if (elapsed < 20ms || elapsed > 1s) throw std::runtime_error("run_for: unexpected duration");
+
+    auto slept = sleep_then_count(service, 10ms, count);
+    service.run_until([&] { return count == 2; });
+
+    // The ring is driven by another loop, woken by an eventfd
+    int efd = eventfd(0, EFD_CLOEXEC) | uio::panic_on_err("eventfd", true);
+    uio::on_scope_exit closefd([&]() { close(efd); });
+    service.register_eventfd(efd);
+
+    auto nop = yield_then_count(service, count);
+    service.poll(); // Submit
+    while (count != 3) {
+        pollfd pfd { .fd = efd, .events = POLLIN };
+        ::poll(&pfd, 1, 1000) | uio::panic_on_err("poll", true);
+        if (!(pfd.revents & POLLIN)) throw std::runtime_error("eventfd: not signalled");
+        eventfd_t value;
+        eventfd_read(efd, &value);
+        service.poll();
+    }
+    service.unregister_eventfd();
+    fmt::print("count: {}\n", count);
+}
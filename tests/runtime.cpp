@@ -0,0 +1,43 @@
+#include <fmt/core.h>
+
+#include <liburing/runtime.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+int main() {
+    using namespace std::chrono_literals;
+
+    std::atomic<int> finished = 0;
+    std::atomic<int> cancelled = 0;
+    {
+        uio::runtime rt(uio::runtime_options { .threads = 4 });
+
+        for (size_t i = 0; i < rt.size() * 4; i++) {
+            rt.spawn_on(i % rt.size(), [&, i] (uio::io_service& service) -> uio::task<> {
+                for (int j = 0; j < 100; j++) {
+                    co_await service.yield();
+                }
+                fmt::print("Task {} finished on thread {}\n", i, gettid());
+                ++finished;
+            });
+        }
+
+        // Blocked until stop() cancels it through the stop token of its worker
+        rt.spawn_on(0, [&] (uio::io_service& service) -> uio::task<> {
+            __kernel_timespec ts = uio::dur2ts(1h);
+            int ret = co_await uio::with_cancel(service.timeout(&ts), *uio::runtime::stop_token());
+            if (ret == -ECANCELED) ++cancelled;
+        });
+
+        std::this_thread::sleep_for(100ms);
+        rt.stop();
+        rt.join();
+
+        if (rt.spawn_on(0, [] (uio::io_service&) -> uio::task<> { co_return; }))
+            uio::panic("spawn_on accepted a task after stop", 0);
+    }
+
+    if (finished != 16 || cancelled != 1)
+        uio::panic("Unexpected result", 0);
+}
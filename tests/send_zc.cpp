@@ -0,0 +1,99 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <array>
+#include <string_view>
+
+// Wait for `flag` to be set by a release callback, which is queued like a coroutine
+auto wait_for(uio::io_service& service, const bool& flag) -> uio::task<> {
+    for (int i = 0; i < 1000 && !flag; i++) {
+        co_await service.yield();
+    }
+    if (!flag) uio::panic("Release callback isn't called", 0);
+}
+
+auto expect_recv(uio::io_service& service, int sockfd, std::string_view expected) -> uio::task<> {
+    std::array<char, 64> buf;
+    int n = co_await service.recv(sockfd, buf.data(), buf.size(), 0) | uio::panic_on_err("recv", false);
+    if (std::string_view(buf.data(), n) != expected)
+        uio::panic("Unexpected message", 0);
+}
+
+auto send_all(uio::io_service& service, int tx, int rx) -> uio::task<> {
+    std::string_view msg = "ping!";
+
+    // The byte count arrives first, then the notification releasing the buffer
+    auto op = service.send_zc(tx, msg.data(), msg.size(), 0);
+    int sent = co_await op;
+    if (sent == -EOPNOTSUPP) {
+        fmt::print("Zero-copy send is not supported by this socket, skipping\n");
+        co_await op.released();
+        co_return;
+    }
+    sent | uio::panic_on_err("send_zc", false);
+    if (sent != int(msg.size())) uio::panic("Unexpected byte count", sent);
+    co_await op.released();
+    if (!op.is_released()) uio::panic("Buffer isn't released", 0);
+    co_await expect_recv(service, rx, msg);
+
+    // A callback set once the buffer is released is still queued
+    bool called = false;
+    op.set_callback([&] { called = true; });
+    co_await wait_for(service, called);
+
+    // A callback set before
+    called = false;
+    auto op2 = service.send_zc(tx, msg.data(), msg.size(), 0);
+    op2.set_callback([&] { called = true; });
+    co_await op2 | uio::panic_on_err("send_zc", false);
+    co_await wait_for(service, called);
+    co_await expect_recv(service, rx, msg);
+
+    // The awaitable is destroyed before the notification, the callback is called anyway
+    called = false;
+    service.send_zc(tx, msg.data(), msg.size(), 0).set_callback([&] { called = true; });
+    co_await wait_for(service, called);
+    co_await expect_recv(service, rx, msg);
+
+    // Same for a message
+    iovec iov { const_cast<char *>(msg.data()), msg.size() };
+    msghdr hdr {};
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    auto op3 = service.sendmsg_zc(tx, &hdr, 0);
+    sent = co_await op3 | uio::panic_on_err("sendmsg_zc", false);
+    if (sent != int(msg.size())) uio::panic("Unexpected byte count", sent);
+    co_await op3.released();
+    co_await expect_recv(service, rx, msg);
+}
+
+int main() {
+    using uio::io_service;
+    using uio::panic_on_err;
+
+    io_service service;
+    if (!service.is_supported(IORING_OP_SEND_ZC)) {
+        fmt::print("Zero-copy send is not supported, skipping\n");
+        return 0;
+    }
+
+    // Unix sockets don't support zero-copy sends, use a pair of loopback UDP sockets instead
+    std::array<int, 2> sv;
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrlen = sizeof(addr);
+    sv[0] = socket(AF_INET, SOCK_DGRAM, 0) | panic_on_err("socket", true);
+    uio::on_scope_exit closerx([&]() { close(sv[0]); });
+    bind(sv[0], reinterpret_cast<sockaddr *>(&addr), addrlen) | panic_on_err("bind", true);
+    getsockname(sv[0], reinterpret_cast<sockaddr *>(&addr), &addrlen) | panic_on_err("getsockname", true);
+    sv[1] = socket(AF_INET, SOCK_DGRAM, 0) | panic_on_err("socket", true);
+    uio::on_scope_exit closetx([&]() { close(sv[1]); });
+    connect(sv[1], reinterpret_cast<sockaddr *>(&addr), addrlen) | panic_on_err("connect", true);
+
+    service.run(send_all(service, sv[1], sv[0]));
+    fmt::print("Zero-copy send works\n");
+}
@@ -0,0 +1,52 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <string_view>
+
+auto echo(uio::io_service& service, int read_fd, int write_fd) -> uio::task<> {
+    std::string_view msg = "ping";
+    char buf[16];
+
+    for (int i = 0; i < 1000; i++) {
+        co_await service.write(write_fd, msg.data(), msg.size(), 0)
+            | uio::panic_on_err("Unable to write to write_fd", false);
+        int n = co_await service.read(read_fd, buf, sizeof(buf), 0)
+            | uio::panic_on_err("Unable to read from read_fd", false);
+        if (std::string_view(buf, n) != msg)
+            uio::panic("Unexpected message", 0);
+    }
+}
+
+int main() {
+    using uio::io_service;
+
+    // Every mode is requested; those unsupported by the running kernel are dropped
+    io_service service(uio::io_service_options {
+        .entries = 32,
+        .cq_entries = 256,
+        .defer_taskrun = true,
+        .coop_taskrun = true,
+    });
+    auto flags = service.setup_flags();
+    fmt::print("CQSIZE: {}, SINGLE_ISSUER: {}, DEFER_TASKRUN: {}, COOP_TASKRUN: {}\n",
+        !!(flags & IORING_SETUP_CQSIZE),
+        !!(flags & IORING_SETUP_SINGLE_ISSUER),
+        !!(flags & IORING_SETUP_DEFER_TASKRUN),
+        !!(flags & IORING_SETUP_COOP_TASKRUN));
+
+    std::array<int, 2> p;
+    pipe(p.data()) | uio::panic_on_err("Unable to open pipe", true);
+    uio::on_scope_exit closepipe([&]() { close(p[0]); close(p[1]); });
+
+    service.run(echo(service, p[0], p[1]));
+
+    // Busy poll the CQ before blocking, with a fixed and an adaptive budget
+    for (bool adaptive : { false, true }) {
+        io_service spinning(uio::io_service_options {
+            .defer_taskrun = true,
+            .spin_budget = std::chrono::microseconds(50),
+            .adaptive_spin = adaptive,
+        });
+        spinning.run(echo(spinning, p[0], p[1]));
+    }
+}
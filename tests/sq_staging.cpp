@@ -0,0 +1,80 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <liburing/when_all.hpp>
+#include <liburing/cancel_token.hpp>
+#include <array>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+
+// Far more requests than the SQ holds, including link chains crossing its capacity
+auto test(uio::io_service& service, int read_fd, int write_fd) -> uio::task<> {
+    std::vector<uio::sqe_awaitable> writes;
+    for (int i = 0; i < 30; i++) {
+        writes.push_back(service.write(write_fd, "x", 1, 0));
+    }
+    fmt::print("staged: {}\n", service.staged_count());
+    if (service.staged_count() == 0)
+        throw std::runtime_error("staging: nothing is staged");
+    auto results = co_await uio::when_all(std::move(writes));
+    for (int res : results) {
+        if (res != 1) throw std::runtime_error("staging: write failed");
+    }
+
+    std::array<char, 64> buffer;
+    int n = co_await service.read(read_fd, buffer.data(), buffer.size(), 0);
+    if (n != 30) throw std::runtime_error("staging: unexpected read");
+
+    // write -> read chains, each read sees the write before it
+    std::vector<uio::sqe_awaitable> chains;
+    for (int i = 0; i < 6; i++) {
+        chains.push_back(service.write(write_fd, "ab", 2, 0, IOSQE_IO_LINK));
+        chains.push_back(service.read(read_fd, buffer.data() + i * 2, 2, 0));
+    }
+    results = co_await uio::when_all(std::move(chains));
+    for (int res : results) {
+        if (res != 2) throw std::runtime_error("staging: chain is broken");
+    }
+    if (std::string_view(buffer.data(), 12) != "abababababab")
+        throw std::runtime_error("staging: unexpected content");
+
+    // An unawaited request is ignored
+    service.write(write_fd, "z", 1, 0);
+    n = co_await service.read(read_fd, buffer.data(), buffer.size(), 0);
+    if (n != 1) throw std::runtime_error("staging: unexpected read");
+
+    // The request takes the last slot of the SQ, its deadline must stay linked to it
+    for (int i = 0; i < 3; i++) {
+        service.write(write_fd, "w", 1, 0);
+    }
+    auto ts = uio::dur2ts(1s);
+    int res = co_await uio::with_timeout(service.timeout(&ts), 10ms);
+    if (res != -ECANCELED) throw std::runtime_error("staging: deadline is dropped");
+    n = co_await service.read(read_fd, buffer.data(), buffer.size(), 0);
+    if (n != 3) throw std::runtime_error("staging: unexpected read");
+
+    // A linked read takes the last slot of the SQ, it's staged along with the write linked to it
+    for (int i = 0; i < 3; i++) {
+        service.write(write_fd, "r", 1, 0);
+    }
+    auto read = service.read(read_fd, buffer.data(), 3, 0, IOSQE_IO_LINK);
+    auto write = service.write(write_fd, "l", 1, 0);
+    auto [nread, nwritten] = co_await uio::when_all(read, write);
+    if (nread != 3 || nwritten != 1 || std::string_view(buffer.data(), 3) != "rrr")
+        throw std::runtime_error("staging: linked request in the last slot is broken");
+    n = co_await service.read(read_fd, buffer.data(), buffer.size(), 0);
+    if (n != 1 || buffer[0] != 'l') throw std::runtime_error("staging: unexpected read");
+}
+
+int main() {
+    uio::io_service service(4);
+
+    std::array<int, 2> p;
+    pipe(p.data()) | uio::panic_on_err("Unable to open pipe", true);
+    uio::on_scope_exit closepipe([&]() { close(p[0]); close(p[1]); });
+
+    service.run(test(service, p[0], p[1]));
+}
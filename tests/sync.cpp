@@ -0,0 +1,128 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <liburing/runtime.hpp>
+#include <liburing/sync.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Coroutines on one ring: critical sections never overlap, even across suspension points
+void test_single_ring() {
+    uio::io_service service;
+    uio::async_mutex mutex;
+    uio::async_condition_variable cv;
+    uio::async_event event;
+    int in_section = 0, overlaps = 0, items = 0, consumed = 0;
+
+    auto worker = [&] () -> uio::task<> {
+        for (int i = 0; i < 10; i++) {
+            auto guard = co_await mutex.scoped_lock();
+            if (in_section++) ++overlaps;
+            co_await service.yield();
+            --in_section;
+        }
+    };
+    auto consumer = [&] () -> uio::task<> {
+        co_await event.wait();
+        co_await mutex.lock();
+        while (!items) co_await cv.wait(mutex);
+        --items;
+        ++consumed;
+        mutex.unlock();
+    };
+
+    service.run([&] () -> uio::task<> {
+        std::vector<uio::task<>> tasks;
+        for (int i = 0; i < 4; i++) tasks.push_back(worker());
+        for (int i = 0; i < 4; i++) tasks.push_back(consumer());
+
+        event.set();
+        for (int i = 0; i < 4; i++) {
+            co_await service.yield();
+            auto guard = co_await mutex.scoped_lock();
+            ++items;
+            cv.notify_one();
+        }
+        for (auto& t : tasks) co_await t;
+    }());
+
+    if (overlaps || consumed != 4) uio::panic("Unexpected result", 0);
+}
+
+// At most `count` holders at once; release(n) hands units over to as many waiters
+void test_semaphore() {
+    uio::io_service service;
+    uio::async_semaphore sem(2);
+    int holders = 0, max_holders = 0, done = 0;
+
+    auto holder = [&] () -> uio::task<> {
+        co_await sem.acquire();
+        max_holders = std::max(max_holders, ++holders);
+        co_await service.yield();
+        --holders;
+        ++done;
+        sem.release();
+    };
+
+    service.run([&] () -> uio::task<> {
+        std::vector<uio::task<>> tasks;
+        for (int i = 0; i < 5; i++) tasks.push_back(holder());
+        for (auto& t : tasks) co_await t;
+    }());
+    if (max_holders != 2 || done != 5 || sem.available() != 2) uio::panic("Unexpected semaphore result", max_holders);
+
+    uio::async_semaphore gate(0);
+    int woken = 0;
+    auto waiter = [&] () -> uio::task<> {
+        co_await gate.acquire();
+        ++woken;
+    };
+    std::vector<uio::task<>> waiters;
+    for (int i = 0; i < 3; i++) waiters.push_back(waiter());
+    if (woken) uio::panic("Acquired without a unit", woken);
+    gate.release(2);
+    if (woken != 2 || gate.available()) uio::panic("Unexpected release(n) result", woken);
+    gate.release(3);
+    if (woken != 3 || gate.available() != 2) uio::panic("Unexpected release(n) result", woken);
+}
+
+// Coroutines on different rings contend for one cross_ring_mutex
+void test_cross_ring() {
+    if (!uio::io_service().is_supported(IORING_OP_MSG_RING)) {
+        fmt::print("IORING_OP_MSG_RING is not supported, skipping\n");
+        return;
+    }
+
+    uio::cross_ring_mutex mutex;
+    std::atomic<int> in_section = 0, overlaps = 0, finished = 0;
+    int counter = 0;
+    {
+        uio::runtime rt(uio::runtime_options { .threads = 4 });
+        for (size_t i = 0; i < rt.size(); i++) {
+            rt.spawn_on(i, [&] (uio::io_service& service) -> uio::task<> {
+                for (int j = 0; j < 1000; j++) {
+                    co_await mutex.lock(service);
+                    if (in_section++) ++overlaps;
+                    ++counter;
+                    if (j % 10 == 0) co_await service.yield();
+                    --in_section;
+                    mutex.unlock(service);
+                }
+                ++finished;
+            });
+        }
+        while (finished != int(rt.size())) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    fmt::print("counter: {}\n", counter);
+    if (overlaps || counter != 4000) uio::panic("Unexpected result", 0);
+}
+
+int main() {
+    test_single_ring();
+    test_semaphore();
+    test_cross_ring();
+}
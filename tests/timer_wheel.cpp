@@ -0,0 +1,51 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <chrono>
+#include <vector>
+
+int main() {
+    using namespace std::chrono_literals;
+    using clock = uio::timer_wheel::clock;
+
+    uio::io_service service;
+    std::vector<int> order;
+    int idle_fired = 0;
+
+    auto sleeper = [&] (int id, std::chrono::milliseconds dur) -> uio::task<> {
+        auto start = clock::now();
+        co_await service.sleep_for(dur);
+        if (clock::now() - start < dur) uio::panic("Woken up early", id);
+        order.push_back(id);
+    };
+
+    service.run([&] () -> uio::task<> {
+        // Many sleeps, no sqe issued for any of them
+        std::vector<uio::task<>> tasks;
+        for (int i = 0; i < 10000; i++) {
+            tasks.push_back(sleeper(1000 + i, std::chrono::milliseconds(30 + i % 20)));
+        }
+        tasks.push_back(sleeper(2, 20ms));
+        tasks.push_back(sleeper(1, 10ms));
+
+        // An idle timeout, pushed back while there's activity
+        uio::timer idle(service.get_timers(), [&] { ++idle_fired; });
+        for (int i = 0; i < 5; i++) {
+            idle.arm_after(15ms);
+            co_await service.sleep_for(5ms);
+        }
+        if (idle_fired) uio::panic("Re-armed timer fired", idle_fired);
+        co_await service.sleep_for(20ms);
+        if (idle_fired != 1) uio::panic("Timer didn't fire", idle_fired);
+
+        uio::timer cancelled(service.get_timers(), [&] { uio::panic("Cancelled timer fired", 0); });
+        cancelled.arm_after(1ms);
+        if (!cancelled.cancel()) uio::panic("Timer wasn't armed", 0);
+
+        for (auto& t : tasks) co_await t;
+        co_await service.sleep_until(clock::now() + 5ms);
+    }());
+
+    if (order.size() != 10002 || order[0] != 1 || order[1] != 2) uio::panic("Unexpected order", order.size());
+    fmt::print("Timers fired in order\n");
+}
@@ -0,0 +1,70 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+#include <liburing/when_all.hpp>
+#include <array>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+
+auto add_later(uio::io_service& service, int a, int b) -> uio::task<int> {
+    co_await service.yield();
+    co_return a + b;
+}
+
+auto fail_later(uio::io_service& service) -> uio::task<> {
+    co_await service.yield();
+    throw std::runtime_error("expected");
+}
+
+auto test(uio::io_service& service, int read_fd, int write_fd) -> uio::task<> {
+    std::array<char, 16> buffer;
+
+    // Requests and tasks together
+    auto [written, sum, nothing] = co_await uio::when_all(
+        service.write(write_fd, "hello", 5, 0),
+        add_later(service, 1, 2),
+        service.yield()
+    );
+    fmt::print("when_all: {} {}\n", written, sum);
+    if (written != 5 || sum != 3 || nothing != 0)
+        throw std::runtime_error("when_all: unexpected results");
+
+    std::vector<uio::sqe_awaitable> reads;
+    reads.push_back(service.read(read_fd, buffer.data(), 2, 0));
+    reads.push_back(service.read(read_fd, buffer.data() + 2, 3, 0));
+    auto lengths = co_await uio::when_all(std::move(reads));
+    if (lengths.size() != 2 || lengths[0] + lengths[1] != 5 || std::string_view(buffer.data(), 5) != "hello")
+        throw std::runtime_error("when_all: unexpected read");
+
+    // Exceptions are rethrown once every operation is finished
+    bool thrown = false;
+    try {
+        co_await uio::when_all(fail_later(service), add_later(service, 3, 4));
+    } catch (std::runtime_error&) {
+        thrown = true;
+    }
+    if (!thrown) throw std::runtime_error("when_all: exception is lost");
+
+    // Nothing is written to the pipe, the read can only be cancelled
+    auto ts = uio::dur2ts(10ms);
+    auto [index, res] = co_await uio::when_any(
+        service.read(read_fd, buffer.data(), buffer.size(), 0),
+        service.timeout(&ts)
+    );
+    fmt::print("when_any: {} {}\n", index, res);
+    if (index != 1 || res != -ETIME)
+        throw std::runtime_error("when_any: unexpected winner");
+}
+
+int main() {
+    uio::io_service service;
+
+    std::array<int, 2> p;
+    pipe(p.data()) | uio::panic_on_err("Unable to open pipe", true);
+    uio::on_scope_exit closepipe([&]() { close(p[0]); close(p[1]); });
+
+    service.run(test(service, p[0], p[1]));
+}
@@ -0,0 +1,81 @@
+#include <fmt/core.h>
+
+#include <liburing/runtime.hpp>
+#include <liburing/work_deque.hpp>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Every item pushed by the owner is taken exactly once, by either the owner or a thief
+void test_deque() {
+    constexpr uintptr_t count = 1000000;
+    uio::work_deque<uintptr_t> deque(256);
+    std::vector<std::atomic<int>> taken(count);
+    std::atomic<bool> done = false;
+
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 3; i++) {
+        thieves.emplace_back([&] {
+            while (!done.load()) {
+                if (auto item = deque.steal()) ++taken[*item];
+            }
+        });
+    }
+
+    for (uintptr_t i = 0; i < count; i++) {
+        while (!deque.push(i)) {
+            if (auto item = deque.pop()) ++taken[*item];
+        }
+        if (i % 3 == 0) {
+            if (auto item = deque.pop()) ++taken[*item];
+        }
+    }
+    while (auto item = deque.pop()) ++taken[*item];
+    done = true;
+    for (auto& t : thieves) t.join();
+
+    for (uintptr_t i = 0; i < count; i++) {
+        if (taken[i] != 1) uio::panic("Item is lost or taken twice", 0);
+    }
+}
+
+// CPU bound coroutines spawned on one worker spread over idle ones
+void test_runtime() {
+    std::mutex mutex;
+    std::set<pid_t> threads;
+    std::atomic<int> finished = 0;
+    {
+        uio::runtime rt(uio::runtime_options { .threads = 4, .work_stealing = true });
+
+        for (int i = 0; i < 16; i++) {
+            rt.spawn_on(0, [&] (uio::io_service&) -> uio::task<> {
+                for (int j = 0; j < 50; j++) {
+                    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(200);
+                    while (std::chrono::steady_clock::now() < until) {}
+                    {
+                        std::lock_guard lock(mutex);
+                        threads.insert(gettid());
+                    }
+                    co_await uio::runtime::reschedule();
+                }
+                // I/O goes to the ring of the worker we are on now
+                co_await uio::runtime::current_service()->yield();
+                ++finished;
+            });
+        }
+
+        while (finished != 16) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    fmt::print("Coroutines ran on {} thread(s)\n", threads.size());
+    if (threads.size() < 2)
+        uio::panic("No coroutine was stolen", 0);
+}
+
+int main() {
+    test_deque();
+    test_runtime();
+}